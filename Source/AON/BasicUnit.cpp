@@ -22,6 +22,8 @@
 #include "DamageEffect.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Materials/MaterialInstanceDynamic.h"
+#include "SingletonManagerActor.h"
+#include "FlannActor.h"
 
 AMOBAPlayerController* ABasicUnit::localPC = 0;
 
@@ -97,7 +99,9 @@ ABasicUnit::ABasicUnit(const FObjectInitializer& ObjectInitializer)
 	DefaultBuffProperty[EHeroBuffProperty::AttackBounsPercentage] = 0;
 	DefaultBuffProperty[EHeroBuffProperty::ArmorBounsConstant] = 0;
 	DefaultBuffProperty[EHeroBuffProperty::ArmorBounsPercentage] = 0;
-
+	// CDO也會跑建構子 這裡只攤平 加總跟移動速度等BeginPlay再算
+	DefaultBuffAggregate.FromMaps(DefaultBuffProperty, DefaultBuffState);
+	BuffAggregate = DefaultBuffAggregate;
 }
 
 void ABasicUnit::OnMouseClicked(UPrimitiveComponent* ClickedComp, FKey ButtonPressed)
@@ -145,6 +149,12 @@ void ABasicUnit::BeginPlay()
 	Super::BeginPlay();
 	GetCapsuleComponent()->OnClicked.AddUniqueDynamic(this, &ABasicUnit::OnMouseClicked);
 	localPC = Cast<AMOBAPlayerController>(GetWorld()->GetFirstPlayerController());
+	// 預設加成可能在編輯器被改過
+	DefaultBuffAggregate.FromMaps(DefaultBuffProperty, DefaultBuffState);
+	BuffAggregate = DefaultBuffAggregate;
+	BuffPropertyMap = DefaultBuffProperty;
+	BuffStateMap = DefaultBuffState;
+	MarkBuffDirty();
 
 	SelectionDecal->SetVisibility(false);
 	isSelection = false;
@@ -168,8 +178,8 @@ void ABasicUnit::BeginPlay()
 
 	// 依等級更新血魔攻速
 	UpdateHPMPAS();
-	CurrentHP = CurrentMaxHP;
-	CurrentMP = CurrentMaxMP;
+	SetCurrentHP(CurrentMaxHP);
+	SetCurrentMP(CurrentMaxMP);
 	CurrentAttackRange = BaseAttackRange;
 	CurrentAttack = BaseAttack;
 	CurrentArmor = BaseArmor;
@@ -190,31 +200,255 @@ void ABasicUnit::BeginPlay()
 
 	MinimumDontMoveDistance = GetCapsuleComponent()->GetScaledCapsuleHalfHeight() + 30;
 	BaseMaterial = GetMesh()->GetMaterial(0);
-	this->CustomTimeDilation = DeltaTimeRatio;
+	// 計時器要記下倍率 不能直接改CustomTimeDilation
+	SetCustomTimeDilation(DeltaTimeRatio);
+
+	// 加入空間索引 之後只有換格子時才更新
+	GetRootComponent()->TransformUpdated.AddUObject(this, &ABasicUnit::OnRootMoved);
+	if (AFlannActor* fa = AFlannActor::Get(this))
+	{
+		fa->RegisterUnit(this);
+	}
+	// 交給管理者統一更新
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->RegisterUnit(this);
+	}
+}
+
+void ABasicUnit::ComputeSimulation(float DeltaTime, FUnitSimulation& Out) const
+{
+	Out.HP = CurrentHP;
+	Out.MP = CurrentMP;
+	// 計算各種自然回復 用的是上次算的回復量
+	if (IsAlive)
+	{
+		Out.HP = FMath::Min(Out.HP + DeltaTime * CurrentRegenHP, CurrentMaxHP);
+		Out.MP = FMath::Min(Out.MP + DeltaTime * CurrentRegenMP, CurrentMaxMP);
+	}
+	// 修正小於0的值為0
+	Out.HP = FMath::Max(Out.HP, 0.f);
+	Out.MP = FMath::Max(Out.MP, 0.f);
+	// 更新血魔攻速 下次回復才用到
+	ComputeHPMPAS(Out);
+}
+
+void ABasicUnit::ApplySimulation(const FUnitSimulation& In)
+{
+	// 值沒變的話Set不會標記同步
+	SetCurrentHP(In.HP);
+	SetCurrentMP(In.MP);
+	ApplyHPMPAS(In);
+}
+
+void ABasicUnit::ApplyTimers(float DeltaTime)
+{
+	Frame++;
+	FollowActorUpdateCounting += DeltaTime;
+
+	// 算CD 技能事件會進藍圖
+	for (int32 i = 0; i < this->Skills.Num(); ++i)
+	{
+		AHeroSkill* skill = this->Skills[i];
+		if (skill)
+		{
+			const uint8 Events = skill->AdvanceCD(DeltaTime);
+			if (Events)
+			{
+				skill->FireCDEvents(Events);
+			}
+		}
+	}
+}
+
+void ABasicUnit::AggregateBuffs()
+{
+	BlendingColor = FLinearColor::White;
+	const FBuffAggregate Last = BuffAggregate;
+	FBuffAggregate Swap = DefaultBuffAggregate;
+	const bool IgnoreUnfriendly = HasBuffState(HEROS::IgnoreUnfriendly);
+	for (AHeroBuff* Buff : Buffs)
+	{
+		if (IsValid(Buff))
+		{
+			if (IgnoreUnfriendly && !Buff->Friendly)
+			{
+				// do nothing
+			}
+			else
+			{
+				// Map改變時Buff自己會RefreshBuffAggregate 這裡只加總
+				Swap.Add(Buff->Aggregate);
+				if (Buff->Aggregate.Has(HEROS::Blending))
+				{
+					BlendingColor = Buff->BlendingColor;
+				}
+			}
+		}
+	}
+	BuffAggregate = Swap;
+	// 藍圖還是讀TMap 只寫回有變的值
+	BuffAggregate.SyncToMaps(Last, BuffPropertyMap, BuffStateMap);
+}
+
+void ABasicUnit::MarkBuffDirty()
+{
+	BuffDirty = true;
+	UpdateBuffs();
+}
+
+void ABasicUnit::UpdateBuffs()
+{
+	// 藍圖事件裡又改buff的話留到下個Tick
+	if (!BuffDirty || UpdatingBuffs)
+	{
+		return;
+	}
+	UpdatingBuffs = true;
+	BuffDirty = false;
+	AggregateBuffs();
+	DamageTableDirty = true;
+	// 移動速度更新
+	{
+		CurrentMoveSpeed = (BaseMoveSpeed + GetBuffProperty(HEROP::MoveSpeedConstant)) * GetBuffProperty(HEROP::MoveSpeedRatio);
+		UCharacterMovementComponent* mc = Cast<UCharacterMovementComponent>(GetMovementComponent());
+		mc->MaxWalkSpeed = CurrentMoveSpeed;
+		mc->MaxWalkSpeedCrouched = CurrentMoveSpeed;
+	}
+	// 更新血魔攻速
+	UpdateHPMPAS();
+	UpdatingBuffs = false;
+}
+
+void ABasicUnit::ApplyBlendingColor()
+{
+	// 只在顏色改變時呼叫 第一次才建立材質實例
+	if (!BlendingMaterial)
+	{
+		BlendingMaterial = GetMesh()->CreateDynamicMaterialInstance(0, BaseMaterial);
+		if (!BlendingMaterial)
+		{
+			return;
+		}
+	}
+	static const FName BlendingColorName(TEXT("BlendingColor"));
+	BlendingMaterial->SetVectorParameterValue(BlendingColorName, BlendingColor);
+}
+
+void ABasicUnit::UpdateStunState()
+{
+	//計算暈眩狀態且沒有無視負面效果狀態
+	if (HasBuffState(HEROS::Stunning) && !HasBuffState(HEROS::IgnoreUnfriendly))
+	{
+		//如果在持續施法中
+		switch (BodyStatus)
+		{
+		case EHeroBodyStatus::SpellChannellingActor:
+		{
+			//強制斷招
+			AHeroSkill* hs = LastUseSkill;
+			hs->IsChannelling = false;
+			hs->BP_ChannellingActorBreak(hs->Victim);
+		}
+		break;
+		case EHeroBodyStatus::SpellChannelling:
+		{
+			//強制斷招
+			AHeroSkill* hs = LastUseSkill;
+			hs->IsChannelling = false;
+			hs->BP_ChannellingBreak(hs->CastPoint);
+		}
+		break;
+		default:
+			break;
+		}
+
+		BodyStatus = EHeroBodyStatus::Stunning;
+		LastMoveTarget = FVector::ZeroVector;
+	}
+	else if (EHeroBodyStatus::Stunning == BodyStatus)
+	{
+		if (!HasBuffState(HEROS::Stunning))
+		{
+			BodyStatus = EHeroBodyStatus::Standing;
+		}
+	}
+}
+
+void ABasicUnit::RefreshDefaultBuff()
+{
+	DefaultBuffAggregate.FromMaps(DefaultBuffProperty, DefaultBuffState);
+	MarkBuffDirty();
+}
+
+const FUnitDamageTable& ABasicUnit::GetDamageTable()
+{
+	if (DamageTableDirty)
+	{
+		DamageTableDirty = false;
+		DamageTable.Build(this);
+	}
+	return DamageTable;
+}
+
+void ABasicUnit::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AFlannActor* fa = AFlannActor::Get(this))
+	{
+		fa->UnregisterUnit(this);
+	}
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->UnregisterUnit(this);
+	}
+	GetRootComponent()->TransformUpdated.RemoveAll(this);
+	Super::EndPlay(EndPlayReason);
+}
+
+void ABasicUnit::OnRootMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (InGrid)
+	{
+		if (AFlannActor* fa = AFlannActor::Get(this))
+		{
+			fa->UpdateUnit(this);
+		}
+	}
 }
 
 // Called every frame
 void ABasicUnit::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
-	Frame++;
-	// 慢慢更新就好
-	if (Frame % 7 == 0)
+	// 有管理者時由ASingletonManagerActor平行先算
+	if (!SimulationManaged)
 	{
-		// 移動速度更新
+		ApplyTimers(DeltaTime);
+		// 慢慢更新就好
+		if (IsSimulationDue())
 		{
-			CurrentMoveSpeed = (BaseMoveSpeed + BuffPropertyMap[HEROP::MoveSpeedConstant]) * BuffPropertyMap[HEROP::MoveSpeedRatio];
-			UCharacterMovementComponent* mc = Cast<UCharacterMovementComponent>(GetMovementComponent());
-			mc->MaxWalkSpeed = CurrentMoveSpeed;
-			mc->MaxWalkSpeedCrouched = CurrentMoveSpeed;
+			FUnitSimulation Sim;
+			ComputeSimulation(DeltaTime, Sim);
+			ApplySimulation(Sim);
 		}
+	}
+	// 時間到的Buff由AHeroBuff呼叫ExpireBuff 這裡只清掉已經消失的
+	if (BuffsPendingPurge)
+	{
+		BuffsPendingPurge = false;
+		Buffs.RemoveAll([](const AHeroBuff* buff) { return !IsValid(buff); });
+		BuffDirty = true;
+	}
+	// buff有變動才重新加總
+	UpdateBuffs();
+	UpdateStunState();
+	// 慢慢更新就好
+	if (Frame % 7 == 0)
+	{
 		if (BlendingColor != LastBlendingColor)
 		{
 			LastBlendingColor = BlendingColor;
-			UMaterialInstanceDynamic* MILight = UMaterialInstanceDynamic::Create(
-				BaseMaterial, this);
-			MILight->SetVectorParameterValue(FName(TEXT("BlendingColor")), BlendingColor);
-			GetMesh()->SetMaterial(0, MILight);
+			ApplyBlendingColor();
 		}
 		// 如果沒有初始化成功就初始化 local AMOBAPlayerController
 		if (!IsValid(localPC))
@@ -230,7 +464,7 @@ void ABasicUnit::Tick(float DeltaTime)
 			{
 				if (IsValid(Buff) && Buff->IsOrb)
 				{
-					if (BuffStateMap[HEROS::IgnoreUnfriendly] && !Buff->Friendly)
+					if (HasBuffState(HEROS::IgnoreUnfriendly) && !Buff->Friendly)
 					{
 						// do nothing
 					}
@@ -256,128 +490,6 @@ void ABasicUnit::Tick(float DeltaTime)
 		{
 			CurrentOrb = nullptr;
 		}
-		// 計算各種buff
-		{
-			BlendingColor = FLinearColor::White;
-			TMap<EHeroBuffProperty, float> SwapProperty = DefaultBuffProperty;
-			TMap<EHeroBuffState, bool> SwapState = DefaultBuffState;
-			for (AHeroBuff* Buff : Buffs)
-			{
-				if (IsValid(Buff))
-				{
-					if (BuffStateMap[HEROS::IgnoreUnfriendly] && !Buff->Friendly)
-					{
-						// do nothing
-					}
-					else
-					{
-						for (auto& Elem : Buff->BuffPropertyMap)
-						{
-							SwapProperty[Elem.Key] += Elem.Value;
-						}
-						for (EHeroBuffState& Elem : Buff->BuffState)
-						{
-							SwapState[Elem] = true;
-							if (Elem == HEROS::Blending)
-							{
-								BlendingColor = Buff->BlendingColor;
-							}
-						}
-					}
-				}
-			}
-
-			BuffStateMap = SwapState;
-			BuffPropertyMap = SwapProperty;
-		}
-		// 更新血魔攻速
-		UpdateHPMPAS();
-		//計算暈眩狀態且沒有無視負面效果狀態
-		if (BuffStateMap[HEROS::Stunning] && !BuffStateMap[HEROS::IgnoreUnfriendly])
-		{
-			//如果在持續施法中
-			switch (BodyStatus)
-			{
-			case EHeroBodyStatus::SpellChannellingActor:
-			{
-				//強制斷招
-				AHeroSkill* hs = LastUseSkill;
-				hs->IsChannelling = false;
-				hs->BP_ChannellingActorBreak(hs->Victim);
-			}
-			break;
-			case EHeroBodyStatus::SpellChannelling:
-			{
-				//強制斷招
-				AHeroSkill* hs = LastUseSkill;
-				hs->IsChannelling = false;
-				hs->BP_ChannellingBreak(hs->CastPoint);
-			}
-			break;
-			default:
-				break;
-			}
-
-			BodyStatus = EHeroBodyStatus::Stunning;
-			LastMoveTarget = FVector::ZeroVector;
-		}
-		else if (EHeroBodyStatus::Stunning == BodyStatus)
-		{
-			if (!BuffStateMap[HEROS::Stunning])
-			{
-				BodyStatus = EHeroBodyStatus::Standing;
-			}
-		}
-		{// 計算各種自然回復
-			if (IsAlive)
-			{
-				CurrentHP += DeltaTime * CurrentRegenHP;
-				CurrentMP += DeltaTime * CurrentRegenMP;
-				if (CurrentHP > CurrentMaxHP)
-				{
-					CurrentHP = CurrentMaxHP;
-				}
-				if (CurrentMP > CurrentMaxMP)
-				{
-					CurrentMP = CurrentMaxMP;
-				}
-			}
-			// 修正小於0的值為0
-			if (CurrentHP < 0)
-			{
-				CurrentHP = 0;
-			}
-			if (CurrentMP < 0)
-			{
-				CurrentMP = 0;
-			}
-		}
-	}
-	//更新再快一點但不用到每個Frame
-	if (Frame % 3 == 0)
-	{
-		// 更新 Buff 持續時間
-		bool isLastFrameStunning = (0 == StunningLeftCounting);
-		StunningLeftCounting = 0;
-		for (int32 i = 0; i < Buffs.Num(); ++i)
-		{
-			// 移除時間到的Buff
-			if (IsValid(Buffs[i]))
-			{
-				if (!Buffs[i]->Forever && Buffs[i]->Duration <= 0)
-				{
-					//呼叫消失事件
-					Buffs[i]->OnDestroy();
-					Buffs.RemoveAt(i);
-					i--;
-				}
-			}
-			else
-			{
-				Buffs.RemoveAt(i);
-				i--;
-			}
-		}
 	}
 	if (LastAnimaStatus != AnimaStatus)
 	{
@@ -391,18 +503,11 @@ void ABasicUnit::Tick(float DeltaTime)
 		if (hud)
 		{
 			// 如果有插旗移動，以最後一根移動旗為準來顯示技能提示
-			int32 lastMoveIndex = -1;
-			for (int32 i = 0; i < ActionQueue.Num(); ++i)
-			{
-				if (ActionQueue[i].ActionStatus == EHeroActionStatus::MoveToPosition)
-				{
-					lastMoveIndex = i;
-				}
-			}
+			const FHeroAction* lastMove = ActionBuffer.FindLastMove();
 			// 如果有按左shift的話顯示插旗後的技能位置
-			if (hud->bLeftShiftDown && lastMoveIndex >= 0)
+			if (hud->bLeftShiftDown && lastMove)
 			{
-				FVector pos = ActionQueue[lastMoveIndex].TargetVec1;
+				FVector pos = lastMove->TargetVec1;
 				pos.Z += 50;
 				CurrentSkillHint->UpdatePos(pos, hud->CurrentMouseHit);
 				CurrentSkillDirection = hud->CurrentMouseHit - pos;
@@ -425,10 +530,11 @@ void ABasicUnit::Tick(float DeltaTime)
 			AHeroBuff* Buff = Buffs[i];
 			if (IsValid(Buff) && Buff->BuffState.Contains(HEROS::Rebirth))
 			{
-				CurrentHP = CurrentMaxHP;
+				SetCurrentHP(CurrentMaxHP);
 				Buff->OnRebirth(this);
 				hasRebirth = true;
 				Buffs.RemoveAt(i);
+				BuffDirty = true;
 				break;
 			}
 		}
@@ -439,7 +545,7 @@ void ABasicUnit::Tick(float DeltaTime)
 			{
 				localPC->ServerCharacterStopMove(this);
 			}
-			IsAlive = false;
+			SetIsAlive(false);
 			GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Visibility, ECR_Ignore);
 			GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Camera, ECR_Ignore);
 			GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_WorldStatic, ECR_Ignore);
@@ -448,7 +554,7 @@ void ABasicUnit::Tick(float DeltaTime)
 			GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_PhysicsBody, ECR_Ignore);
 			GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Vehicle, ECR_Ignore);
 			GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Destructible, ECR_Ignore);
-			CurrentHP = 0;
+			SetCurrentHP(0);
 			// TODO: event dead
 			AMOBAGameState* ags = Cast<AMOBAGameState>(UGameplayStatics::GetGameState(GetWorld()));
 			if (ags && IsValid(localPC))
@@ -466,27 +572,20 @@ void ABasicUnit::Tick(float DeltaTime)
 			}
 		}
 	}
-	AttackingCounting += DeltaTime;
-	FollowActorUpdateCounting += DeltaTime;
-	SpellingCounting += DeltaTime;
-
-	// 算CD
-	for (int32 i = 0; i < this->Skills.Num(); ++i)
+	// 藍圖直接改了ActionQueue的話照藍圖的內容重建
+	if (Role == ROLE_Authority)
 	{
-		if (this->Skills[i])
-		{
-			this->Skills[i]->CheckCD(DeltaTime);
-		}
+		ApplyBlueprintActionQueue();
 	}
 	// 是否有動作？
-	if (ActionQueue.Num() > 0 && IsAlive && EHeroBodyStatus::Stunning != BodyStatus)
+	if (ActionBuffer.Num() > 0 && IsAlive && EHeroBodyStatus::Stunning != BodyStatus)
 	{
-		//GEngine->AddOnScreenDebugMessage(-1, 0.1f, FColor::Magenta, FString::Printf(L"ActionQueue %d", ActionQueue.Num()));
+		//GEngine->AddOnScreenDebugMessage(-1, 0.1f, FColor::Magenta, FString::Printf(L"ActionQueue %d", ActionBuffer.Num()));
 		// 動作駐列最上層動作是否為當前動作
-		if (ActionQueue[0] != CurrentAction)
+		if (ActionBuffer.First() != CurrentAction)
 		{
 			// 拿出動作
-			CurrentAction = ActionQueue[0];
+			CurrentAction = ActionBuffer.First();
 			// 進入此狀態的有限狀態機來做事
 			DoAction(CurrentAction);
 		}
@@ -501,7 +600,7 @@ void ABasicUnit::Tick(float DeltaTime)
 			// 推出事件
 			PopAction();
 			// 檢查動作駐列是否為空？
-			if (ActionQueue.Num() == 0)
+			if (ActionBuffer.Num() == 0)
 			{
 				// 站立不動
 				DoNothing();
@@ -528,6 +627,7 @@ void ABasicUnit::AddBuff(AHeroBuff* buff, ABasicUnit* caster)
 		Buffs[i]->OnAddBuff(caster, this, buff);
 	}
 	Buffs.Add(buff);
+	buff->RefreshBuffAggregate();
 	buff->BuffTarget.Add(this);
 	if (buff->BuffTargetOne == nullptr)
 	{
@@ -567,6 +667,8 @@ void ABasicUnit::AddBuff(AHeroBuff* buff, ABasicUnit* caster)
 			break;
 		}
 	}
+	MarkBuffDirty();
+	buff->TryRegisterAura();
 }
 
 AHeroBuff* ABasicUnit::GetBuffByName(FString name)
@@ -613,6 +715,7 @@ void ABasicUnit::AddUniqueBuff(AHeroBuff* buff, ABasicUnit* caster)
 	{
 		buff->BuffTargetOne = this;
 	}
+	buff->RefreshBuffAggregate();
 	buff->BuffTarget.Add(this);
 	if (buff->FollowActor)
 	{
@@ -650,6 +753,8 @@ void ABasicUnit::AddUniqueBuff(AHeroBuff* buff, ABasicUnit* caster)
 	{
 		Buffs.Add(buff);
 	}
+	MarkBuffDirty();
+	buff->TryRegisterAura();
 }
 
 void ABasicUnit::RemoveBuffByName(FString name, ABasicUnit* caster)
@@ -664,6 +769,7 @@ void ABasicUnit::RemoveBuffByName(FString name, ABasicUnit* caster)
 			i--;
 		}
 	}
+	MarkBuffDirty();
 }
 
 void ABasicUnit::RemoveBuff(AHeroBuff* buff, ABasicUnit* caster)
@@ -673,6 +779,19 @@ void ABasicUnit::RemoveBuff(AHeroBuff* buff, ABasicUnit* caster)
 	{
 		Buffs[i]->OnRemoveBuff(caster, this, buff);
 	}
+	MarkBuffDirty();
+}
+
+void ABasicUnit::ExpireBuff(AHeroBuff* buff)
+{
+	if (!Buffs.Contains(buff))
+	{
+		return;
+	}
+	//呼叫消失事件
+	buff->OnDestroy();
+	Buffs.RemoveSingle(buff);
+	MarkBuffDirty();
 }
 
 void ABasicUnit::RemoveFriendlyBuff(ABasicUnit* caster)
@@ -692,6 +811,7 @@ void ABasicUnit::RemoveFriendlyBuff(ABasicUnit* caster)
 			i--;
 		}
 	}
+	MarkBuffDirty();
 }
 
 void ABasicUnit::RemoveUnfriendlyBuff(ABasicUnit* caster)
@@ -711,6 +831,7 @@ void ABasicUnit::RemoveUnfriendlyBuff(ABasicUnit* caster)
 			i--;
 		}
 	}
+	MarkBuffDirty();
 }
 
 // Called to bind functionality to input
@@ -781,7 +902,7 @@ bool ABasicUnit::TriggerSkill(int32 index, FVector Pos, ABasicUnit* CurrentTarge
 				else if (hs->SkillBehavior[EHeroBehavior::UnitTarget])
 				{
 					//確認是否被禁止指定技
-					if (!CurrentTarget->BuffStateMap[HEROS::BanBeSkillSight] &&
+					if (!CurrentTarget->HasBuffState(HEROS::BanBeSkillSight) &&
 						hs->SkillBehavior[HEROB((int)HEROB::UnitTarget_HeroUnit+ (int)CurrentTarget->UnitType)])
 					{
 						localPC->ServerHeroUseSkill(this, EHeroActionStatus::SpellToActor, index, dir, Pos, CurrentTarget);
@@ -840,39 +961,67 @@ void ABasicUnit::HideSkillHint()
 
 void ABasicUnit::UpdateHPMPAS()
 {
-	CurrentMaxHP = BaseHP;
-	CurrentRegenHP = BaseRegenHP * BuffPropertyMap[HEROP::HealPercentage];
-	CurrentMaxMP = BaseMP;
-	CurrentRegenMP = BaseRegenMP;
-	CurrentAttack = (((BaseAttack + BuffPropertyMap[HEROP::AttackBounsConstantWhite])*
-		(1 + BuffPropertyMap[HEROP::AttackBounsPercentage]) + BuffPropertyMap[HEROP::AttackBounsConstantGreen])*
-		BuffPropertyMap[HEROP::PhysicalDamageOutputPercentage]);
-
-	CurrentAttackSpeed = (100 + (100 * BuffPropertyMap[HEROP::AttackSpeedConstant])) *
-		BuffPropertyMap[HEROP::AttackSpeedRatio] * 0.01;
-	CurrentAttackSpeedSecond = BaseAttackSpeedSecond / (1 + CurrentAttackSpeed);
-	CurrentArmor = BaseArmor;
-	if (CurrentAttackSpeedSecond > 0)
+	FUnitSimulation Sim;
+	ComputeHPMPAS(Sim);
+	ApplyHPMPAS(Sim);
+}
+
+void ABasicUnit::ComputeHPMPAS(FUnitSimulation& Out) const
+{
+	Out.MaxHP = BaseHP;
+	Out.RegenHP = BaseRegenHP * GetBuffProperty(HEROP::HealPercentage);
+	Out.MaxMP = BaseMP;
+	Out.RegenMP = BaseRegenMP;
+	Out.Attack = (((BaseAttack + GetBuffProperty(HEROP::AttackBounsConstantWhite))*
+		(1 + GetBuffProperty(HEROP::AttackBounsPercentage)) + GetBuffProperty(HEROP::AttackBounsConstantGreen))*
+		GetBuffProperty(HEROP::PhysicalDamageOutputPercentage));
+
+	Out.AttackSpeed = (100 + (100 * GetBuffProperty(HEROP::AttackSpeedConstant))) *
+		GetBuffProperty(HEROP::AttackSpeedRatio) * 0.01;
+	Out.AttackSpeedSecond = BaseAttackSpeedSecond / (1 + Out.AttackSpeed);
+	Out.Armor = BaseArmor;
+	// 沒有攻速時保留原本的值
+	Out.AttackingAnimationTimeLength = CurrentAttackingAnimationTimeLength;
+	Out.AttackingAnimationRate = CurrentAttackingAnimationRate;
+	Out.AttackingBeginingTimeLength = CurrentAttackingBeginingTimeLength;
+	Out.AttackingEndingTimeLength = CurrentAttackingEndingTimeLength;
+	if (Out.AttackSpeedSecond > 0)
 	{
 		if (BaseAttackingAnimationTimeLength > 0)
 		{
-			CurrentAttackingAnimationTimeLength = BaseAttackingAnimationTimeLength / CurrentAttackSpeedSecond;
+			Out.AttackingAnimationTimeLength = BaseAttackingAnimationTimeLength / Out.AttackSpeedSecond;
 		}
 		if (BaseAttackingAnimationTimeLength > 0)
 		{
-			CurrentAttackingAnimationRate = BaseAttackingAnimationTimeLength / CurrentAttackSpeedSecond;
+			Out.AttackingAnimationRate = BaseAttackingAnimationTimeLength / Out.AttackSpeedSecond;
 		}
 		if (BaseAttackingBeginingTimeLength > 0)
 		{
-			CurrentAttackingBeginingTimeLength = BaseAttackingBeginingTimeLength / CurrentAttackSpeed;
+			Out.AttackingBeginingTimeLength = BaseAttackingBeginingTimeLength / Out.AttackSpeed;
 		}
 		if (BaseAttackingEndingTimeLength > 0)
 		{
-			CurrentAttackingEndingTimeLength = BaseAttackingEndingTimeLength / CurrentAttackSpeed;
+			Out.AttackingEndingTimeLength = BaseAttackingEndingTimeLength / Out.AttackSpeed;
 		}
 	}
 }
 
+void ABasicUnit::ApplyHPMPAS(const FUnitSimulation& In)
+{
+	CurrentMaxHP = In.MaxHP;
+	CurrentRegenHP = In.RegenHP;
+	CurrentMaxMP = In.MaxMP;
+	CurrentRegenMP = In.RegenMP;
+	CurrentAttack = In.Attack;
+	CurrentAttackSpeed = In.AttackSpeed;
+	CurrentAttackSpeedSecond = In.AttackSpeedSecond;
+	CurrentArmor = In.Armor;
+	CurrentAttackingAnimationTimeLength = In.AttackingAnimationTimeLength;
+	CurrentAttackingAnimationRate = In.AttackingAnimationRate;
+	CurrentAttackingBeginingTimeLength = In.AttackingBeginingTimeLength;
+	CurrentAttackingEndingTimeLength = In.AttackingEndingTimeLength;
+}
+
 float ABasicUnit::GetSkillCDPercent(int32 n)
 {
 	if (n > 0 && n < this->Skills.Num())
@@ -1053,7 +1202,7 @@ UWebInterfaceJsonObject* ABasicUnit::BuildJsonObject()
 			//CD百分比
 			wjo->SetNumber(FString::Printf(TEXT("Skill%d_CDPercent"), i + 1), this->Skills[i]->GetSkillCDPercent());
 			//目前CD時間
-			wjo->SetNumber(FString::Printf(TEXT("Skill%d_CurrentCD"), i + 1), this->Skills[i]->CurrentCD);
+			wjo->SetNumber(FString::Printf(TEXT("Skill%d_CurrentCD"), i + 1), this->Skills[i]->GetCurrentCD());
 			//目前最大CD時間
 			wjo->SetNumber(FString::Printf(TEXT("Skill%d_MaxCD"), i + 1), this->Skills[i]->MaxCD);
 			//該技能目前可不可以升級
@@ -1086,7 +1235,7 @@ UWebInterfaceJsonObject* ABasicUnit::BuildJsonObject()
 			//Buff堆疊成數
 			wjo->SetNumber(FString::Printf(TEXT("Buff%d_Stacks"), i + 1), Buffs[i]->Stacks);
 			//Buff持續剩餘時間
-			wjo->SetNumber(FString::Printf(TEXT("Buff%d_Duration"), i + 1), Buffs[i]->Duration);
+			wjo->SetNumber(FString::Printf(TEXT("Buff%d_Duration"), i + 1), Buffs[i]->GetDuration());
 			//Buff持續總時間
 			wjo->SetNumber(FString::Printf(TEXT("Buff%d_MaxDuration"), i + 1), Buffs[i]->MaxDuration);
 			//Buff是否可堆疊
@@ -1173,7 +1322,7 @@ bool ABasicUnit::UseSkill(EHeroActionStatus SpellType, int32 index, FVector VFac
 		{
 			hs->StartCD();
 		}
-		CurrentMP -= hs->CurrnetManaCost;
+		SetCurrentMP(CurrentMP - hs->CurrnetManaCost);
 		if (hs->SkillBehavior[HEROB::Channelled])
 		{
 			BP_PlayChannelling(hs->ChannellingTime, 1);
@@ -1358,6 +1507,142 @@ bool ABasicUnit::CheckCurrentActionFinish()
 void ABasicUnit::SetCustomTimeDilation(float v)
 {
 	this->CustomTimeDilation = v;
+	// 計時器用記下來的舊倍率算到現在 再用新的倍率重新起算跟排CD
+	SetAttackingCounting(GetAttackingCounting());
+	SetSpellingCounting(GetSpellingCounting());
+	for (AHeroSkill* skill : Skills)
+	{
+		if (skill)
+		{
+			skill->SyncCD();
+			skill->ScheduleCD();
+		}
+	}
+}
+
+// 從設定值的時間開始 依當時記下的倍率累積 倍率是0時停住
+// CustomTimeDilation不會同步 客戶端只能用同步過來的倍率
+static float CountingSince(const ABasicUnit* Unit, float Value, float StartTime, float Rate)
+{
+	if (Rate <= 0)
+	{
+		return Value;
+	}
+	return Value + (AMOBAGameState::GetServerWorldTime(Unit) - StartTime) * Rate;
+}
+
+float ABasicUnit::GetAttackingCounting() const
+{
+	return CountingSince(this, AttackingCounting, AttackStartTime, AttackTimeRate);
+}
+
+void ABasicUnit::SetAttackingCounting(float Value)
+{
+	AttackingCounting = Value;
+	AttackStartTime = AMOBAGameState::GetServerWorldTime(this);
+	AttackTimeRate = CustomTimeDilation;
+}
+
+float ABasicUnit::GetSpellingCounting() const
+{
+	return CountingSince(this, SpellingCounting, SpellStartTime, SpellTimeRate);
+}
+
+void ABasicUnit::SetSpellingCounting(float Value)
+{
+	SpellingCounting = Value;
+	SpellStartTime = AMOBAGameState::GetServerWorldTime(this);
+	SpellTimeRate = CustomTimeDilation;
+}
+
+// 值有變才標記 等PreReplication一起打包
+template<typename T>
+static void SetCombatValue(T& Field, T Value, bool& Dirty)
+{
+	if (Field != Value)
+	{
+		Field = Value;
+		Dirty = true;
+	}
+}
+
+void ABasicUnit::SetCurrentHP(float Value)
+{
+	SetCombatValue(CurrentHP, Value, CombatStateDirty);
+}
+
+void ABasicUnit::SetCurrentMP(float Value)
+{
+	SetCombatValue(CurrentMP, Value, CombatStateDirty);
+}
+
+void ABasicUnit::SetCurrentShield(float Value)
+{
+	SetCombatValue(CurrentShield, Value, CombatStateDirty);
+}
+
+void ABasicUnit::SetCurrentShieldPhysical(float Value)
+{
+	SetCombatValue(CurrentShieldPhysical, Value, CombatStateDirty);
+}
+
+void ABasicUnit::SetCurrentShieldMagical(float Value)
+{
+	SetCombatValue(CurrentShieldMagical, Value, CombatStateDirty);
+}
+
+void ABasicUnit::SetCurrentSkillPoints(int32 Value)
+{
+	SetCombatValue(CurrentSkillPoints, Value, CombatStateDirty);
+}
+
+void ABasicUnit::SetIsAlive(bool Value)
+{
+	if (IsAlive == Value)
+	{
+		return;
+	}
+	SetCombatValue(IsAlive, Value, CombatStateDirty);
+	// 死掉跟復活都留在格子裡 讓光環重新檢查這個單位
+	if (AFlannActor* fa = AFlannActor::Get(this))
+	{
+		fa->UpdateUnit(this);
+	}
+}
+
+void ABasicUnit::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	// 同一個Frame改幾次都只加一次Revision 沒改的單位網路比對只看Revision
+	if (CombatStateDirty)
+	{
+		CombatStateDirty = false;
+		FUnitCombatState Next;
+		Next.HP = CurrentHP;
+		Next.MP = CurrentMP;
+		Next.Shield = CurrentShield;
+		Next.ShieldPhysical = CurrentShieldPhysical;
+		Next.ShieldMagical = CurrentShieldMagical;
+		Next.SkillPoints = CurrentSkillPoints;
+		Next.IsAlive = IsAlive;
+		// 改了又改回上次送出的值 不用再送
+		if (!Next.SameValues(CombatState))
+		{
+			Next.Revision = CombatState.Revision + 1;
+			CombatState = Next;
+		}
+	}
+	Super::PreReplication(ChangedPropertyTracker);
+}
+
+void ABasicUnit::OnRep_CombatState()
+{
+	CurrentHP = CombatState.HP;
+	CurrentMP = CombatState.MP;
+	CurrentShield = CombatState.Shield;
+	CurrentShieldPhysical = CombatState.ShieldPhysical;
+	CurrentShieldMagical = CombatState.ShieldMagical;
+	CurrentSkillPoints = CombatState.SkillPoints;
+	IsAlive = CombatState.IsAlive;
 }
 
 bool ABasicUnit::DoAction_Validate(const FHeroAction& CurrentAction)
@@ -1518,9 +1803,9 @@ void ABasicUnit::DoAction_MovingAttackToPosition(const FHeroAction& CurrentActio
 			break;
 		case EHeroBodyStatus::AttackWating:
 		{
-			if (AttackingCounting > CurrentAttackSpeedSecond)
+			if (GetAttackingCounting() > CurrentAttackSpeedSecond)
 			{
-				AttackingCounting = 0;
+				SetAttackingCounting(0);
 				BodyStatus = EHeroBodyStatus::AttackBegining;
 				ServerPlayAttack(CurrentSpellingAnimationTimeLength, CurrentAttackingAnimationRate);
 				PlayAttack = true;
@@ -1531,21 +1816,14 @@ void ABasicUnit::DoAction_MovingAttackToPosition(const FHeroAction& CurrentActio
 		break;
 		case EHeroBodyStatus::AttackBegining:
 		{
-			if (!IsAttacked && AttackingCounting > CurrentAttackingBeginingTimeLength)
+			if (!IsAttacked && GetAttackingCounting() > CurrentAttackingBeginingTimeLength)
 			{
 				IsAttacked = true;
 
 				// 遠攻傷害
 				if (AttackBullet)
 				{
-					FVector pos = GetActorLocation();
-					ABulletActor* bullet = GetWorld()->SpawnActor<ABulletActor>(AttackBullet);
-					if (bullet)
-					{
-						bullet->SetActorLocation(pos);
-						bullet->SetTargetActor(this, TargetActor);
-						bullet->Damage = this->CurrentAttack;
-					}
+					ServerLaunchBullet(TargetActor);
 				}
 				else
 				{// 近戰傷害
@@ -1560,7 +1838,7 @@ void ABasicUnit::DoAction_MovingAttackToPosition(const FHeroAction& CurrentActio
 		break;
 		case EHeroBodyStatus::AttackEnding:
 		{
-			if (AttackingCounting > CurrentAttackingBeginingTimeLength + CurrentAttackingEndingTimeLength)
+			if (GetAttackingCounting() > CurrentAttackingBeginingTimeLength + CurrentAttackingEndingTimeLength)
 			{
 				BodyStatus = EHeroBodyStatus::Standing;
 			}
@@ -1748,14 +2026,90 @@ void ABasicUnit::DoAction_MoveToPositionImpl(const FHeroAction& CurrentAction)
 	}
 }
 
+TArray<FHeroAction> ABasicUnit::GetQueuedActions() const
+{
+	return ActionBuffer.ToArray();
+}
+
+int32 ABasicUnit::GetQueuedActionNum() const
+{
+	return ActionBuffer.Num();
+}
+
+FHeroAction ABasicUnit::GetQueuedAction(int32 index) const
+{
+	if (index < 0 || index >= ActionBuffer.Num())
+	{
+		return FHeroAction();
+	}
+	return ActionBuffer[index];
+}
+
+void ABasicUnit::SetQueuedAction(const FHeroAction& action)
+{
+	ActionBuffer.Empty();
+	ActionBuffer.Add(action);
+	SyncActionQueue();
+}
+
+bool ABasicUnit::AppendQueuedAction(const FHeroAction& action)
+{
+	if (!ActionBuffer.Add(action))
+	{
+		return false;
+	}
+	SyncActionQueue();
+	return true;
+}
+
+void ABasicUnit::ClearQueuedActions()
+{
+	ActionBuffer.Empty();
+	SyncActionQueue();
+}
+
+void ABasicUnit::SyncActionQueue()
+{
+	ActionQueue = ActionBuffer.ToArray();
+}
+
+void ABasicUnit::ApplyBlueprintActionQueue()
+{
+	bool Same = ActionQueue.Num() == ActionBuffer.Num();
+	for (int32 i = 0; Same && i < ActionQueue.Num(); ++i)
+	{
+		Same = ActionQueue[i] == ActionBuffer[i];
+	}
+	if (Same)
+	{
+		return;
+	}
+	ActionBuffer.Empty();
+	for (const FHeroAction& action : ActionQueue)
+	{
+		if (!ActionBuffer.Add(action))
+		{
+			break;
+		}
+	}
+	// 超過上限的不收
+	SyncActionQueue();
+}
+
+void ABasicUnit::OnRep_ActionBuffer()
+{
+	SyncActionQueue();
+}
+
 void ABasicUnit::PopAction()
 {
-	if (ActionQueue.Num() > 0)
+	if (ActionBuffer.Num() > 0)
 	{
-		ActionQueue.RemoveAt(0);
-		if (ActionQueue.Num() > 0)
+		ActionBuffer.Pop();
+		SyncActionQueue();
+		if (ActionBuffer.Num() > 0)
 		{
-			CurrentAction = ActionQueue[0];
+			CurrentAction = ActionBuffer.First();
 		}
 		else
 		{
@@ -1817,9 +2171,9 @@ void ABasicUnit::DoAction_AttackActor(const FHeroAction& CurrentAction)
 		break;
 	case EHeroBodyStatus::AttackWating:
 	{
-		if (AttackingCounting > CurrentAttackSpeedSecond)
+		if (GetAttackingCounting() > CurrentAttackSpeedSecond)
 		{
-			AttackingCounting = 0;
+			SetAttackingCounting(0);
 			BodyStatus = EHeroBodyStatus::AttackBegining;
 			if (IsValid(CurrentOrb))
 			{
@@ -1838,21 +2192,14 @@ void ABasicUnit::DoAction_AttackActor(const FHeroAction& CurrentAction)
 	break;
 	case EHeroBodyStatus::AttackBegining:
 	{
-		if (!IsAttacked && AttackingCounting > CurrentAttackingBeginingTimeLength)
+		if (!IsAttacked && GetAttackingCounting() > CurrentAttackingBeginingTimeLength)
 		{
 			IsAttacked = true;
 
 			// 遠攻傷害
 			if (AttackBullet)
 			{
-				FVector pos = GetActorLocation();
-				ABulletActor* bullet = GetWorld()->SpawnActor<ABulletActor>(AttackBullet);
-				if (bullet)
-				{
-					bullet->SetActorLocation(pos);
-					bullet->SetTargetActor(this, TargetActor);
-					bullet->Damage = this->CurrentAttack;
-				}
+				ServerLaunchBullet(TargetActor);
 			}
 			else
 			{// 近戰傷害
@@ -1867,7 +2214,7 @@ void ABasicUnit::DoAction_AttackActor(const FHeroAction& CurrentAction)
 	break;
 	case EHeroBodyStatus::AttackEnding:
 	{
-		if (AttackingCounting > CurrentAttackingBeginingTimeLength + CurrentAttackingEndingTimeLength)
+		if (GetAttackingCounting() > CurrentAttackingBeginingTimeLength + CurrentAttackingEndingTimeLength)
 		{
 			BodyStatus = EHeroBodyStatus::Standing;
 		}
@@ -1883,6 +2230,26 @@ void ABasicUnit::DoAction_AttackActor(const FHeroAction& CurrentAction)
 	}
 }
 
+bool ABasicUnit::ServerLaunchBullet_Validate(ABasicUnit* target)
+{
+	return true;
+}
+
+void ABasicUnit::ServerLaunchBullet_Implementation(ABasicUnit* target)
+{
+	// 伺服器也會跑到 那顆子彈負責結算傷害
+	if (!AttackBullet)
+	{
+		return;
+	}
+	ABulletActor* bullet = ASingletonManagerActor::Acquire<ABulletActor>(GetWorld(), AttackBullet, FTransform(GetActorLocation()));
+	if (bullet)
+	{
+		bullet->SetTargetActor(this, target);
+		bullet->Damage = this->CurrentAttack;
+	}
+}
+
 bool ABasicUnit::ServerShowDamageEffect_Validate(FVector pos, FVector dir, float Damage)
 {
 	return true;
@@ -1891,7 +2258,14 @@ void ABasicUnit::ServerShowDamageEffect_Implementation(FVector pos, FVector dir,
 {
 	if (Role < ROLE_Authority)
 	{
-		ADamageEffect* TempDamageText = GetWorld()->SpawnActor<ADamageEffect>(ShowDamageEffect);
+		// 有MHUD時飄字交給HUD一起畫
+		AMHUD* hud = IsValid(localPC) ? Cast<AMHUD>(localPC->GetHUD()) : nullptr;
+		if (hud && ShowDamageEffect)
+		{
+			hud->AddDamageNumber(ShowDamageEffect->GetDefaultObject<ADamageEffect>(), pos, dir, (int32)Damage);
+			return;
+		}
+		ADamageEffect* TempDamageText = ASingletonManagerActor::Acquire<ADamageEffect>(GetWorld(), ShowDamageEffect, FTransform::Identity);
 		if (TempDamageText)
 		{
 			TempDamageText->OriginPosition = pos;
@@ -2050,7 +2424,7 @@ void ABasicUnit::DoAction_SpellToActor(const FHeroAction& CurrentAction)
 		if (this->Skills[CurrentAction.TargetIndex1]->GetMaxCastRange() + TargetActor->BodySize > DistanceToTargetActor)
 		{
 			BodyStatus = EHeroBodyStatus::SpellWating;
-			SpellingCounting = 0;
+			SetSpellingCounting(0);
 		}
 		else
 		{
@@ -2072,7 +2446,7 @@ void ABasicUnit::DoAction_SpellToActor(const FHeroAction& CurrentAction)
 				localPC->ServerCharacterStopMove(this);
 			}
 			BodyStatus = EHeroBodyStatus::SpellWating;
-			SpellingCounting = 0;
+			SetSpellingCounting(0);
 		}
 		else if (FollowActorUpdateCounting > FollowActorUpdateTimeGap)
 		{
@@ -2088,9 +2462,9 @@ void ABasicUnit::DoAction_SpellToActor(const FHeroAction& CurrentAction)
 		break;
 	case EHeroBodyStatus::SpellWating:
 	{
-		if (SpellingCounting >= CurrentSpellingWatingTimeLength)
+		if (GetSpellingCounting() >= CurrentSpellingWatingTimeLength)
 		{
-			SpellingCounting = 0;
+			SetSpellingCounting(0);
 			BodyStatus = EHeroBodyStatus::SpellBegining;
 			ServerPlayAttack(CurrentSpellingAnimationTimeLength, CurrentSpellingRate);
 			if (Role == ROLE_Authority)
@@ -2107,16 +2481,16 @@ void ABasicUnit::DoAction_SpellToActor(const FHeroAction& CurrentAction)
 	break;
 	case EHeroBodyStatus::SpellBegining:
 	{
-		if (SpellingCounting > CurrentSpellingBeginingTimeLength)
+		if (GetSpellingCounting() > CurrentSpellingBeginingTimeLength)
 		{
 			if (LastUseSkillAction != CurrentAction)
 			{
 				BodyStatus = EHeroBodyStatus::SpellEnding;
-				SpellingCounting = 0;
+				SetSpellingCounting(0);
 				if (IsValid(localPC))
 				{
 					//確認是否被禁止指定技
-					if (!CurrentAction.TargetActor->BuffStateMap[HEROS::BanBeSkillSight])
+					if (!CurrentAction.TargetActor->HasBuffState(HEROS::BanBeSkillSight))
 					{
 						localPC->ServerHeroUseSkill(this, CurrentAction.ActionStatus, CurrentAction.TargetIndex1,
 							CurrentAction.TargetVec1, CurrentAction.TargetVec2, CurrentAction.TargetActor);
@@ -2137,7 +2511,7 @@ void ABasicUnit::DoAction_SpellToActor(const FHeroAction& CurrentAction)
 	break;
 	case EHeroBodyStatus::SpellEnding:
 	{
-		if (AttackingCounting > CurrentAttackingBeginingTimeLength + CurrentAttackingEndingTimeLength)
+		if (GetAttackingCounting() > CurrentAttackingBeginingTimeLength + CurrentAttackingEndingTimeLength)
 		{
 			BodyStatus = EHeroBodyStatus::Standing;
 		}
@@ -2192,17 +2566,17 @@ void ABasicUnit::DoAction_SpellToDirection(const FHeroAction& CurrentAction)
 	case EHeroBodyStatus::Standing:
 	{
 		BodyStatus = EHeroBodyStatus::SpellWating;
-		SpellingCounting = 0;
+		SetSpellingCounting(0);
 	}
 	break;
 	case EHeroBodyStatus::Stunning:
 		break;
 	case EHeroBodyStatus::SpellWating:
 	{
-		if (SpellingCounting > CurrentSpellingWatingTimeLength)
+		if (GetSpellingCounting() > CurrentSpellingWatingTimeLength)
 		{
 			BodyStatus = EHeroBodyStatus::SpellBegining;
-			SpellingCounting = 0;
+			SetSpellingCounting(0);
 			if (Role == ROLE_Authority)
 			{
 				for (int32 i = 0; i < Buffs.Num(); ++i)
@@ -2217,12 +2591,12 @@ void ABasicUnit::DoAction_SpellToDirection(const FHeroAction& CurrentAction)
 	{
 		if (Role == ROLE_Authority)
 		{
-			if (SpellingCounting >= CurrentSpellingBeginingTimeLength)
+			if (GetSpellingCounting() >= CurrentSpellingBeginingTimeLength)
 			{
 				if (LastUseSkillAction != CurrentAction)
 				{
 					BodyStatus = EHeroBodyStatus::SpellEnding;
-					SpellingCounting = 0;
+					SetSpellingCounting(0);
 					if (IsValid(localPC))
 					{
 						localPC->ServerHeroUseSkill(this, CurrentAction.ActionStatus, CurrentAction.TargetIndex1,
@@ -2244,7 +2618,7 @@ void ABasicUnit::DoAction_SpellToDirection(const FHeroAction& CurrentAction)
 	break;
 	case EHeroBodyStatus::SpellEnding:
 	{
-		if (SpellingCounting > CurrentSpellingBeginingTimeLength)
+		if (GetSpellingCounting() > CurrentSpellingBeginingTimeLength)
 		{
 			BodyStatus = EHeroBodyStatus::Standing;
 		}
@@ -2288,13 +2662,17 @@ void ABasicUnit::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLife
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 	DOREPLIFETIME(ABasicUnit, Equipments);
-	DOREPLIFETIME(ABasicUnit, CurrentHP);
-	DOREPLIFETIME(ABasicUnit, CurrentMP);
+	DOREPLIFETIME(ABasicUnit, CombatState);
 	DOREPLIFETIME(ABasicUnit, BodyStatus);
-	DOREPLIFETIME(ABasicUnit, ActionQueue);
+	DOREPLIFETIME(ABasicUnit, ActionBuffer);
 	DOREPLIFETIME(ABasicUnit, Buffs);
 	DOREPLIFETIME(ABasicUnit, CurrentAction);
 	DOREPLIFETIME(ABasicUnit, AttackingCounting);
+	DOREPLIFETIME(ABasicUnit, AttackStartTime);
+	DOREPLIFETIME(ABasicUnit, SpellingCounting);
+	DOREPLIFETIME(ABasicUnit, SpellStartTime);
+	DOREPLIFETIME(ABasicUnit, AttackTimeRate);
+	DOREPLIFETIME(ABasicUnit, SpellTimeRate);
 	DOREPLIFETIME(ABasicUnit, CurrentSkillIndex);
 	DOREPLIFETIME(ABasicUnit, Skills);
 	DOREPLIFETIME(ABasicUnit, CurrentAttackSpeedSecond);
@@ -2302,11 +2680,7 @@ void ABasicUnit::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLife
 	DOREPLIFETIME(ABasicUnit, LastUseSkillAction);
 	DOREPLIFETIME(ABasicUnit, LastUseSkill);
 	DOREPLIFETIME(ABasicUnit, AnimaStatus);
-	DOREPLIFETIME(ABasicUnit, IsAlive);
 	DOREPLIFETIME(ABasicUnit, CurrentAttackingBeginingTimeLength);
 	DOREPLIFETIME(ABasicUnit, CurrentAttackingEndingTimeLength);
-	DOREPLIFETIME(ABasicUnit, CurrentShield);
-	DOREPLIFETIME(ABasicUnit, CurrentShieldPhysical);
-	DOREPLIFETIME(ABasicUnit, CurrentShieldMagical);
 	
 }
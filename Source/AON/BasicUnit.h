@@ -9,6 +9,10 @@
 #include "HeroAction.h"
 #include <Components/AudioComponent.h>
 #include "MobaEnum.h"
+#include "BuffAggregate.h"
+#include "DamageTable.h"
+#include "UnitCombatState.h"
+#include "UnitSimulation.h"
 #include "BasicUnit.generated.h"
 
 class ABulletActor;
@@ -21,6 +25,7 @@ class AMOBAPlayerController;
 class UWebInterfaceJsonValue;
 class UWebInterfaceJsonObject;
 class UParticleSystemComponent;
+class UMaterialInstanceDynamic;
 
 UCLASS()
 class AON_API ABasicUnit : public ACharacter
@@ -35,6 +40,11 @@ protected:
 	//Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	//移動時更新空間索引的格子
+	void OnRootMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
 public:	
 	//Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -165,6 +175,9 @@ public:
 	//移除Buff
 	UFUNCTION(BlueprintCallable, Category = "MOBA")
 	void RemoveBuff(AHeroBuff* buff, class ABasicUnit* caster);
+
+	//Buff的Duration到了 呼叫消失事件後移除
+	void ExpireBuff(AHeroBuff* buff);
 	
 	//移除所有正面狀態
 	UFUNCTION(BlueprintCallable, Category = "MOBA")
@@ -177,6 +190,10 @@ public:
 	UFUNCTION(NetMulticast, WithValidation, Unreliable, BlueprintCallable)
 	void ServerShowDamageEffect(FVector pos, FVector dir, float Damage);
 
+	//每台機器自己生子彈 不同步子彈actor 傷害只由伺服器的子彈結算
+	UFUNCTION(NetMulticast, WithValidation, Unreliable)
+	void ServerLaunchBullet(ABasicUnit* target);
+
 	UFUNCTION(BlueprintImplementableEvent)
 	void BP_PlayAttack(float duraction, float rate);
 
@@ -250,6 +267,9 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA")
 	FVector2D	ScreenPosition;
 
+	//HUD最後一次投影到這個單位的編號 跟HUD的ScreenStamp一樣代表在畫面內
+	uint32 ScreenStamp = 0;
+
 	//移動攻擊時，遇到敵人開始追敵人時的位置
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA")
 	FVector	StartFollowPosition;
@@ -384,12 +404,12 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
 	int32 CurrentSkillIndex = -1;
 
-	//剩餘的升級技能點數
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	//剩餘的升級技能點數 經由CombatState同步
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetCurrentSkillPoints, Category = "MOBA|Current")
 	int32 CurrentSkillPoints = 0;
 
-	//是否活著
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	//是否活著 經由CombatState同步
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetIsAlive, Category = "MOBA|Current")
 	bool IsAlive = true;
 
 	/*
@@ -453,12 +473,33 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current")
 	float ChannellingTime = 0;
 
-	//攻擊計時器
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	//攻擊計時器 AttackStartTime當下的值 現在的值用GetAttackingCounting算
+	UPROPERTY(EditAnywhere, BlueprintGetter = GetAttackingCounting, BlueprintSetter = SetAttackingCounting, Category = "MOBA|Current", Replicated)
 	float AttackingCounting = 0;
-	//施法計時器
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Counting", Replicated)
+	//施法計時器 SpellStartTime當下的值 現在的值用GetSpellingCounting算
+	UPROPERTY(EditAnywhere, BlueprintGetter = GetSpellingCounting, BlueprintSetter = SetSpellingCounting, Category = "MOBA|Counting", Replicated)
 	float SpellingCounting = 0;
+	//設定AttackingCounting時的伺服器時間 只在歸零時同步 客戶端自己算經過的時間
+	UPROPERTY(Replicated)
+	float AttackStartTime = 0;
+	//設定SpellingCounting時的伺服器時間
+	UPROPERTY(Replicated)
+	float SpellStartTime = 0;
+	//AttackStartTime之後用的時間倍率 CustomTimeDilation不同步 客戶端用這個算
+	UPROPERTY(Replicated)
+	float AttackTimeRate = 1;
+	//SpellStartTime之後用的時間倍率
+	UPROPERTY(Replicated)
+	float SpellTimeRate = 1;
+
+	UFUNCTION(BlueprintGetter)
+	float GetAttackingCounting() const;
+	UFUNCTION(BlueprintSetter)
+	void SetAttackingCounting(float Value);
+	UFUNCTION(BlueprintGetter)
+	float GetSpellingCounting() const;
+	UFUNCTION(BlueprintSetter)
+	void SetSpellingCounting(float Value);
 	//追踨目標計時器
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Counting")
 	float FollowActorUpdateCounting = 0;
@@ -475,21 +516,48 @@ public:
 	//最大魔力
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current")
 	float CurrentMaxMP;
-	//血量
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	//血量 血魔護盾技能點跟存活都要用Set改 才會標記同步
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetCurrentHP, Category = "MOBA|Current")
 	float CurrentHP;
 	//魔力
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetCurrentMP, Category = "MOBA|Current")
 	float CurrentMP;
 	//通用護盾值
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetCurrentShield, Category = "MOBA|Current")
 	float CurrentShield = 0;
 	//物理護盾值
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetCurrentShieldPhysical, Category = "MOBA|Current")
 	float CurrentShieldPhysical = 0;
 	//魔法護盾值
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetCurrentShieldMagical, Category = "MOBA|Current")
 	float CurrentShieldMagical = 0;
+
+	UFUNCTION(BlueprintSetter)
+	void SetCurrentHP(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetCurrentMP(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetCurrentShield(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetCurrentShieldPhysical(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetCurrentShieldMagical(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetCurrentSkillPoints(int32 Value);
+	UFUNCTION(BlueprintSetter)
+	void SetIsAlive(bool Value);
+
+	//血魔護盾技能點跟存活的同步快照 有標記才在PreReplication打包
+	UPROPERTY(Transient, ReplicatedUsing = OnRep_CombatState)
+	FUnitCombatState CombatState;
+
+	//第一次同步一定要打包
+	bool CombatStateDirty = true;
+
+	UFUNCTION()
+	void OnRep_CombatState();
+
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
 	//每秒回血
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current")
 	float CurrentRegenHP;
@@ -520,6 +588,10 @@ public:
 	//暫存mesh材質的地方
 	UMaterialInterface* BaseMaterial;
 
+	//混色用的材質 第一次變色時建立 之後只改參數
+	UPROPERTY()
+	UMaterialInstanceDynamic* BlendingMaterial = nullptr;
+
 	//當前模型混色
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
 	FLinearColor BlendingColor = FLinearColor::White;
@@ -532,10 +604,47 @@ public:
 
 	int32 LastAnimaStatus = 0;
 
-	//依序做完裡面的動作
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
+	//依序做完裡面的動作 C++只用這個 網路上只送Head跟Count
+	UPROPERTY(ReplicatedUsing = OnRep_ActionBuffer)
+	FHeroActionQueue ActionBuffer;
+
+	//ActionBuffer的複本 給原本就在用的藍圖讀寫
+	//伺服器每個Tick比對 藍圖改過的話照這個重建ActionBuffer
+	//新的藍圖請用下面的函式 不用每次複製
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current")
 	TArray<FHeroAction> ActionQueue;
 
+	//ActionBuffer改變後寫回ActionQueue
+	void SyncActionQueue();
+
+	//藍圖改了ActionQueue就照它重建ActionBuffer
+	void ApplyBlueprintActionQueue();
+
+	UFUNCTION()
+	void OnRep_ActionBuffer();
+
+	//動作駐列的複本 給藍圖看
+	UFUNCTION(BlueprintPure, Category = "MOBA")
+	TArray<FHeroAction> GetQueuedActions() const;
+
+	UFUNCTION(BlueprintPure, Category = "MOBA")
+	int32 GetQueuedActionNum() const;
+
+	//第index個動作 0是目前要做的 超出範圍回傳Default動作
+	UFUNCTION(BlueprintPure, Category = "MOBA")
+	FHeroAction GetQueuedAction(int32 index) const;
+
+	//清空後放入一個動作
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void SetQueuedAction(const FHeroAction& action);
+
+	//插旗 滿了回傳false 玩家的插旗由ServerAppendHeroAction推掉最舊的再放
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	bool AppendQueuedAction(const FHeroAction& action);
+
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void ClearQueuedActions();
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current", Replicated)
 	FHeroAction CurrentAction;
 
@@ -565,6 +674,77 @@ public:
 	//預設加成
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA|Current")
 	TMap<EHeroBuffProperty, float> DefaultBuffProperty;
+
+	//當前加成跟狀態 攤平成陣列 C++都讀這個
+	FBuffAggregate BuffAggregate;
+
+	//預設加成跟狀態 攤平成陣列
+	FBuffAggregate DefaultBuffAggregate;
+
+	//傷害結算用的爆擊格檔表 buff有變動時標記 結算時才重建 要用GetDamageTable讀
+	FUnitDamageTable DamageTable;
+	bool DamageTableDirty = true;
+
+	const FUnitDamageTable& GetDamageTable();
+
+	FORCEINLINE float GetBuffProperty(EHeroBuffProperty p) const
+	{
+		return BuffAggregate.Get(p);
+	}
+
+	FORCEINLINE bool HasBuffState(EHeroBuffState s) const
+	{
+		return BuffAggregate.Has(s);
+	}
+
+	//持續施法 技能CD 要在遊戲執行緒上呼叫
+	void ApplyTimers(float DeltaTime);
+
+	//這一幀要更新血魔攻速 ApplyTimers之後才準
+	FORCEINLINE bool IsSimulationDue() const
+	{
+		return Frame % 7 == 0;
+	}
+
+	//自然回復跟血魔攻速 只讀不寫 可以在工作執行緒上算
+	//由ASingletonManagerActor平行呼叫或自己的Tick呼叫
+	void ComputeSimulation(float DeltaTime, FUnitSimulation& Out) const;
+
+	//寫回ComputeSimulation的結果 要在遊戲執行緒上呼叫
+	void ApplySimulation(const FUnitSimulation& In);
+
+	//UpdateHPMPAS的只讀部分
+	void ComputeHPMPAS(FUnitSimulation& Out) const;
+
+	void ApplyHPMPAS(const FUnitSimulation& In);
+
+	//是否由ASingletonManagerActor先算計時 自己的Tick只跑狀態機
+	bool SimulationManaged = false;
+
+	//加總所有buff
+	void AggregateBuffs();
+
+	//buff有增減或數值改變 馬上重新加總
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void MarkBuffDirty();
+
+	//有標記才重新加總 並更新跑速與血魔攻速
+	void UpdateBuffs();
+
+	//依暈眩狀態更新BodyStatus
+	void UpdateStunState();
+
+	// 把BlendingColor套到模型上
+	void ApplyBlendingColor();
+
+	bool BuffDirty = true;
+	bool UpdatingBuffs = false;
+	//有Buff消失了 下個Tick從Buffs移掉
+	bool BuffsPendingPurge = false;
+
+	//修改DefaultBuffProperty或DefaultBuffState後呼叫
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void RefreshDefaultBuff();
 	
 	//最後一次移動的位置
 	FVector LastMoveTarget = FVector::ZeroVector;
@@ -579,5 +759,9 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "MOBA|Current")
 	TMap<FString, UParticleSystemComponent*> AuraParticles;
 
+	//在空間索引中的格子
+	FIntPoint GridCell;
+	bool InGrid = false;
+
 	static AMOBAPlayerController* localPC;
 };
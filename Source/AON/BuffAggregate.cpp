@@ -0,0 +1,64 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BuffAggregate.h"
+
+
+void FBuffAggregate::FromMaps(const TMap<EHeroBuffProperty, float>& PropertyMap, const TMap<EHeroBuffState, bool>& StateMap)
+{
+	Reset();
+	for (const auto& Elem : PropertyMap)
+	{
+		if (Elem.Key < EHeroBuffProperty::EndBuffProperty)
+		{
+			Set(Elem.Key, Elem.Value);
+		}
+	}
+	for (const auto& Elem : StateMap)
+	{
+		if (Elem.Key < EHeroBuffState::EndBuffKind)
+		{
+			SetState(Elem.Key, Elem.Value);
+		}
+	}
+}
+
+void FBuffAggregate::FromMaps(const TMap<EHeroBuffProperty, float>& PropertyMap, const TArray<EHeroBuffState>& States)
+{
+	Reset();
+	for (const auto& Elem : PropertyMap)
+	{
+		if (Elem.Key < EHeroBuffProperty::EndBuffProperty)
+		{
+			Set(Elem.Key, Elem.Value);
+		}
+	}
+	for (EHeroBuffState Elem : States)
+	{
+		if (Elem < EHeroBuffState::EndBuffKind)
+		{
+			SetState(Elem, true);
+		}
+	}
+}
+
+void FBuffAggregate::SyncToMaps(const FBuffAggregate& Last, TMap<EHeroBuffProperty, float>& PropertyMap, TMap<EHeroBuffState, bool>& StateMap) const
+{
+	for (int32 i = 0; i < (int32)EHeroBuffProperty::EndBuffProperty; ++i)
+	{
+		if (Property[i] != Last.Property[i])
+		{
+			PropertyMap.FindOrAdd((EHeroBuffProperty)i) = Property[i];
+		}
+	}
+	const uint32 changed = State ^ Last.State;
+	if (changed)
+	{
+		for (int32 i = 0; i < (int32)EHeroBuffState::EndBuffKind; ++i)
+		{
+			if (changed & (1u << i))
+			{
+				StateMap.FindOrAdd((EHeroBuffState)i) = Has((EHeroBuffState)i);
+			}
+		}
+	}
+}
@@ -0,0 +1,85 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/VectorRegister.h"
+#include "MobaEnum.h"
+
+static_assert((int32)EHeroBuffState::EndBuffKind <= 32, "FBuffAggregate::State is a 32 bit mask");
+
+// 攤平的Buff加成 列舉是連續的所以直接用陣列跟bitmask取代TMap
+// 加總時一次處理4個float
+struct AON_API FBuffAggregate
+{
+	// 補到4的倍數
+	static const int32 PropertyCount = ((int32)EHeroBuffProperty::EndBuffProperty + 3) & ~3;
+
+	float Property[PropertyCount];
+	uint32 State;
+
+	FBuffAggregate()
+	{
+		Reset();
+	}
+
+	FORCEINLINE void Reset()
+	{
+		FMemory::Memzero(Property, sizeof(Property));
+		State = 0;
+	}
+
+	FORCEINLINE float Get(EHeroBuffProperty p) const
+	{
+		return Property[(int32)p];
+	}
+
+	FORCEINLINE void Set(EHeroBuffProperty p, float v)
+	{
+		Property[(int32)p] = v;
+	}
+
+	FORCEINLINE bool Has(EHeroBuffState s) const
+	{
+		return (State & (1u << (uint32)s)) != 0;
+	}
+
+	FORCEINLINE void SetState(EHeroBuffState s, bool v)
+	{
+		if (v)
+		{
+			State |= (1u << (uint32)s);
+		}
+		else
+		{
+			State &= ~(1u << (uint32)s);
+		}
+	}
+
+	// 加總另一組加成 狀態取聯集
+	FORCEINLINE void Add(const FBuffAggregate& Other)
+	{
+		for (int32 i = 0; i < PropertyCount; i += 4)
+		{
+			VectorStore(VectorAdd(VectorLoad(&Property[i]), VectorLoad(&Other.Property[i])), &Property[i]);
+		}
+		State |= Other.State;
+	}
+
+	bool operator==(const FBuffAggregate& Other) const
+	{
+		return State == Other.State && FMemory::Memcmp(Property, Other.Property, sizeof(Property)) == 0;
+	}
+
+	bool operator!=(const FBuffAggregate& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	// 從編輯器用的TMap轉過來
+	void FromMaps(const TMap<EHeroBuffProperty, float>& PropertyMap, const TMap<EHeroBuffState, bool>& StateMap);
+	void FromMaps(const TMap<EHeroBuffProperty, float>& PropertyMap, const TArray<EHeroBuffState>& States);
+
+	// 把有變動的值寫回TMap 給藍圖讀
+	void SyncToMaps(const FBuffAggregate& Last, TMap<EHeroBuffProperty, float>& PropertyMap, TMap<EHeroBuffState, bool>& StateMap) const;
+};
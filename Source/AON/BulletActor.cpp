@@ -2,8 +2,8 @@
 #include "BulletActor.h"
 #include "HeroCharacter.h"
 #include "MOBAPlayerController.h"
-#include "UnrealNetwork.h"
 #include "Particles/ParticleSystemComponent.h"
+#include "SingletonManagerActor.h"
 
 ABulletActor::ABulletActor(const FObjectInitializer& ObjectInitializer)
     : Super(FObjectInitializer::Get())
@@ -21,13 +21,27 @@ ABulletActor::ABulletActor(const FObjectInitializer& ObjectInitializer)
 	ActiveBulletParticleDied = true;
     DestoryCount = 0;
     TargetActor = NULL;
-	bReplicates = true;
+	// 每台機器由ServerLaunchBullet自己生 不同步 才能在伺服器上回收
+	bReplicates = false;
 }
 
 // Called when the game starts or when spawned
 void ABulletActor::BeginPlay()
 {
     Super::BeginPlay();
+    if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+    {
+        sm->RegisterActor(this);
+    }
+}
+
+void ABulletActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+    {
+        sm->UnregisterActor(this);
+    }
+    Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -53,8 +67,8 @@ void ABulletActor::Tick(float DeltaTime)
         }
         if(BreakDistance > dis)
         {
-			// 在client不要呼叫不然會產生2個子彈
-			if (Role == ROLE_Authority)
+			// 客戶端的子彈只是外觀 傷害只由伺服器那顆結算
+			if (GetNetMode() != NM_Client)
 			{
 				ABasicUnit::localPC->ServerAttackCompute(
 					Attacker, TargetActor, EDamageType::DAMAGE_PHYSICAL, Damage, true);
@@ -80,20 +94,38 @@ void ABulletActor::Tick(float DeltaTime)
         DestoryCount += DeltaTime;
         if(DestoryCount > DestroyDelay)
         {
-            Destroy();
+            ASingletonManagerActor::Release(this);
         }
     }
 }
 
+void ABulletActor::OnPoolAcquired()
+{
+    PrepareDestory = false;
+    DestoryCount = 0;
+    BulletParticle->Activate(true);
+    FlyParticle->Activate(true);
+    if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+    {
+        sm->RegisterActor(this);
+    }
+}
+
+void ABulletActor::OnPoolReleased()
+{
+    if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+    {
+        sm->UnregisterActor(this);
+    }
+    BulletParticle->Deactivate();
+    FlyParticle->Deactivate();
+    TargetActor = NULL;
+    Attacker = NULL;
+}
+
 void ABulletActor::SetTargetActor(ABasicUnit* attacker, ABasicUnit* TActor)
 {
     TargetActor = TActor;
 	Attacker = attacker;
 }
 
-void ABulletActor::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLifetimeProps) const
-{
-	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME(ABulletActor, Attacker);
-	DOREPLIFETIME(ABulletActor, TargetActor);
-}
@@ -3,12 +3,13 @@
 #pragma once
 
 #include "GameFramework/Actor.h"
+#include "PooledActor.h"
 #include "BulletActor.generated.h"
 
 class ABasicUnit;
 
 UCLASS()
-class AON_API ABulletActor : public AActor
+class AON_API ABulletActor : public AActor, public IPooledActor
 {
 	GENERATED_UCLASS_BODY()	
 
@@ -19,9 +20,16 @@ public:
 	// Sets default values for this actor's properties
 	ABulletActor();
 		
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// Called every frame
 	virtual void Tick( float DeltaSeconds ) override;
 
+	// 從池子拿出來 重設飛行狀態
+	virtual void OnPoolAcquired() override;
+
+	virtual void OnPoolReleased() override;
+
 	UPROPERTY(Category = "MOBA", VisibleAnywhere, BlueprintReadOnly)
 	UParticleSystemComponent* BulletParticle;
 	
@@ -56,10 +64,10 @@ public:
 	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
 	uint32  PrepareDestory: 1;
 
-	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite, Replicated)
+	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
 	ABasicUnit* Attacker;
 
-	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite, Replicated)
+	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
 	ABasicUnit* TargetActor;
 
 	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
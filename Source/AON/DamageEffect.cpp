@@ -3,6 +3,7 @@
 #include "DamageEffect.h"
 // for GEngine
 #include "Engine.h"
+#include "SingletonManagerActor.h"
 
 FRotator ADamageEffect::FaceDirection;
 
@@ -41,9 +42,22 @@ void ADamageEffect::PostInitializeComponents()
 void ADamageEffect::BeginPlay()
 {
 	Super::BeginPlay();
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->RegisterActor(this);
+	}
 	
 }
 
+void ADamageEffect::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->UnregisterActor(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void ADamageEffect::Tick( float DeltaTime )
 {
@@ -51,7 +65,8 @@ void ADamageEffect::Tick( float DeltaTime )
 	TimeCounting += DeltaTime;
 	if (TimeCounting > Deadline)
 	{
-		this->ConditionalBeginDestroy();
+		ASingletonManagerActor::Release(this);
+		return;
 	}
 	if (TextMaterial->IsValidLowLevel() && DamageAlpha)
 	{
@@ -59,7 +74,8 @@ void ADamageEffect::Tick( float DeltaTime )
 		TextMaterial->SetScalarParameterValue(TEXT("Alpha"), alpha);
 		if (alpha < 0.01)
 		{
-			this->Destroy();
+			ASingletonManagerActor::Release(this);
+			return;
 		}
 	}
 	if (OriginPosition != FVector::ZeroVector && DamageHeight)
@@ -73,6 +89,25 @@ void ADamageEffect::Tick( float DeltaTime )
 	}
 }
 
+void ADamageEffect::OnPoolAcquired()
+{
+	TimeCounting = 0;
+	SetActorRotation(FaceDirection);
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->RegisterActor(this);
+	}
+}
+
+void ADamageEffect::OnPoolReleased()
+{
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->UnregisterActor(this);
+	}
+	OriginPosition = FVector::ZeroVector;
+}
+
 void ADamageEffect::SetString(FString message)
 {
 	TextRender->SetText(FText::FromString(message));
@@ -5,11 +5,12 @@
 #include "GameFramework/Actor.h"
 #include "Components/TextRenderComponent.h"
 #include "Curves/CurveFloat.h"
+#include "PooledActor.h"
 #include "DamageEffect.generated.h"
 
 
 UCLASS()
-class AON_API ADamageEffect : public AActor
+class AON_API ADamageEffect : public AActor, public IPooledActor
 {
 	GENERATED_UCLASS_BODY()
 	
@@ -18,8 +19,15 @@ public:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 	
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// Called every frame
 	virtual void Tick( float DeltaSeconds ) override;
+
+	// 從池子拿出來 重新計時
+	virtual void OnPoolAcquired() override;
+
+	virtual void OnPoolReleased() override;
 	
 	void SetString(FString message);
 
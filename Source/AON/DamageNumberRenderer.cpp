@@ -0,0 +1,161 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DamageNumberRenderer.h"
+#include "Engine/Canvas.h"
+#include "Engine/Font.h"
+#include "Engine/Texture2D.h"
+#include "SceneView.h"
+#include "DamageEffect.h"
+
+void FDamageNumberRenderer::Add(const ADamageEffect* Style, const FVector& Origin, const FVector& Direction, int32 Value)
+{
+	if (!Style)
+	{
+		return;
+	}
+	FDamageNumber& Number = Numbers[Numbers.AddUninitialized()];
+	Number.Style = Style;
+	Number.Origin = Origin;
+	Number.Direction = Direction.GetSafeNormal();
+	Number.Time = 0;
+	Number.Value = Value;
+	Number.Position = Origin;
+	Number.Alpha = 1;
+}
+
+void FDamageNumberRenderer::Update(float DeltaSeconds)
+{
+	for (int32 i = Numbers.Num() - 1; i >= 0; --i)
+	{
+		FDamageNumber& Number = Numbers[i];
+		const ADamageEffect* Style = Number.Style;
+		Number.Time += DeltaSeconds;
+		// 跟ADamageEffect::Tick一樣的結束條件
+		Number.Alpha = Style->DamageAlpha ? Style->DamageAlpha->GetFloatValue(Number.Time) : 1;
+		if (Number.Time > Style->Deadline || Number.Alpha < 0.01)
+		{
+			Numbers.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+		Number.Position = Number.Origin + Number.Direction * Number.Time * 100;
+		if (Style->DamageHeight)
+		{
+			Number.Position.Z += Style->DamageHeight->GetFloatValue(Number.Time);
+		}
+	}
+}
+
+void FDamageNumberRenderer::Draw(UCanvas* Canvas)
+{
+	if (!Canvas || !Canvas->SceneView || Numbers.Num() == 0)
+	{
+		return;
+	}
+	const FSceneView* View = Canvas->SceneView;
+	const FVector ViewUp = View->GetViewUp();
+	for (const FDamageNumber& Number : Numbers)
+	{
+		if (!View->ViewFrustum.IntersectPoint(Number.Position))
+		{
+			continue;
+		}
+		const ADamageEffect* Style = Number.Style;
+		UTextRenderComponent* Text = Style->TextRender;
+		UFont* Font = Text->Font;
+		if (!Font)
+		{
+			continue;
+		}
+		// 字的世界高度投影成pixel
+		const float WorldHeight = Text->WorldSize * Style->ScaleSize;
+		const FVector2D Center(Canvas->Project(Number.Position));
+		const FVector2D Top(Canvas->Project(Number.Position + ViewUp * WorldHeight));
+		const float PixelHeight = FVector2D::Distance(Center, Top);
+		FLinearColor Color(Text->TextRenderColor);
+		Color.A *= Number.Alpha;
+		AddGlyphs(Canvas, Font, Number, Color, PixelHeight, Center);
+	}
+	FlushGlyphs(Canvas);
+}
+
+void FDamageNumberRenderer::FlushGlyphs(UCanvas* Canvas)
+{
+	for (int32 i = 0; i < Triangles.Num(); ++i)
+	{
+		if (Triangles[i].Num() > 0 && GlyphFont && GlyphFont->Textures.IsValidIndex(i) && GlyphFont->Textures[i])
+		{
+			FCanvasTriangleItem TriItem(Triangles[i], GlyphFont->Textures[i]->Resource);
+			TriItem.BlendMode = SE_BLEND_Translucent;
+			Canvas->DrawItem(TriItem);
+		}
+		Triangles[i].Reset();
+	}
+	GlyphFont = nullptr;
+}
+
+void FDamageNumberRenderer::AddGlyphs(UCanvas* Canvas, UFont* Font, const FDamageNumber& Number, const FLinearColor& Color, float PixelHeight, const FVector2D& Center)
+{
+	TCHAR Digits[16];
+	const int32 Len = FCString::Snprintf(Digits, ARRAY_COUNT(Digits), TEXT("%d"), Number.Value);
+	if (Font->FontCacheType != EFontCacheType::Offline || Font->Characters.Num() == 0)
+	{
+		// 執行期字型交給canvas 同字型的字還是會併成一批
+		FCanvasTextItem TextItem(Center, FText::FromString(Digits), Font, Color);
+		TextItem.bCentreX = true;
+		TextItem.bCentreY = true;
+		Canvas->DrawItem(TextItem);
+		return;
+	}
+	// 通常所有飄字同一個字型 換字型時先畫掉上一批
+	if (GlyphFont != Font)
+	{
+		FlushGlyphs(Canvas);
+		GlyphFont = Font;
+	}
+	if (Triangles.Num() < Font->Textures.Num())
+	{
+		Triangles.SetNum(Font->Textures.Num());
+	}
+	const float Scale = PixelHeight / FMath::Max(1.f, Font->GetMaxCharHeight());
+	float Width = 0;
+	for (int32 i = 0; i < Len; ++i)
+	{
+		Width += Font->Characters[Font->RemapChar(Digits[i])].USize * Scale;
+	}
+	float X = Center.X - Width * 0.5f;
+	const float Y = Center.Y - PixelHeight * 0.5f;
+	for (int32 i = 0; i < Len; ++i)
+	{
+		const FFontCharacter& Char = Font->Characters[Font->RemapChar(Digits[i])];
+		const float W = Char.USize * Scale;
+		if (!Font->Textures.IsValidIndex(Char.TextureIndex) || !Font->Textures[Char.TextureIndex])
+		{
+			X += W;
+			continue;
+		}
+		UTexture2D* Tex = Font->Textures[Char.TextureIndex];
+		const float InvW = 1.f / Tex->GetSurfaceWidth();
+		const float InvH = 1.f / Tex->GetSurfaceHeight();
+		const FVector2D UV0(Char.StartU * InvW, Char.StartV * InvH);
+		const FVector2D UV1((Char.StartU + Char.USize) * InvW, (Char.StartV + Char.VSize) * InvH);
+		const float Top = Y + Char.VerticalOffset * Scale;
+		const float H = Char.VSize * Scale;
+		// 一個字兩個三角形 顏色跟透明度放在頂點上
+		FCanvasUVTri* Tri = &Triangles[Char.TextureIndex][Triangles[Char.TextureIndex].AddUninitialized(2)];
+		Tri[0].V0_Pos = FVector2D(X, Top);
+		Tri[0].V1_Pos = FVector2D(X + W, Top);
+		Tri[0].V2_Pos = FVector2D(X + W, Top + H);
+		Tri[0].V0_UV = UV0;
+		Tri[0].V1_UV = FVector2D(UV1.X, UV0.Y);
+		Tri[0].V2_UV = UV1;
+		Tri[1].V0_Pos = FVector2D(X, Top);
+		Tri[1].V1_Pos = FVector2D(X + W, Top + H);
+		Tri[1].V2_Pos = FVector2D(X, Top + H);
+		Tri[1].V0_UV = UV0;
+		Tri[1].V1_UV = UV1;
+		Tri[1].V2_UV = FVector2D(UV0.X, UV1.Y);
+		Tri[0].V0_Color = Tri[0].V1_Color = Tri[0].V2_Color = Color;
+		Tri[1].V0_Color = Tri[1].V1_Color = Tri[1].V2_Color = Color;
+		X += W;
+	}
+}
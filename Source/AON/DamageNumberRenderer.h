@@ -0,0 +1,53 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CanvasItem.h"
+
+class ADamageEffect;
+class UCanvas;
+class UFont;
+
+// 一個飄字 樣式用ADamageEffect藍圖的預設值
+struct FDamageNumber
+{
+	const ADamageEffect* Style;
+	FVector Origin;
+	FVector Direction;
+	float Time;
+	int32 Value;
+	// 這個Frame算好的位置跟透明度
+	FVector Position;
+	float Alpha;
+};
+
+// 所有飄字共用的繪製器 不生成Actor
+// 曲線在同一個迴圈算完 字形四邊形依字型貼圖分批 每張貼圖畫一次
+class AON_API FDamageNumberRenderer
+{
+public:
+	void Add(const ADamageEffect* Style, const FVector& Origin, const FVector& Direction, int32 Value);
+
+	// 時間前進 算曲線 移除結束的
+	void Update(float DeltaSeconds);
+
+	void Draw(UCanvas* Canvas);
+
+	int32 Num() const { return Numbers.Num(); }
+
+private:
+	// 離線字型直接組字形四邊形 其它字型用FCanvasTextItem
+	void AddGlyphs(UCanvas* Canvas, UFont* Font, const FDamageNumber& Number, const FLinearColor& Color, float PixelHeight, const FVector2D& Center);
+
+	// 每張字型貼圖畫一次
+	void FlushGlyphs(UCanvas* Canvas);
+
+	TArray<FDamageNumber> Numbers;
+
+	// 字型貼圖編號對應的三角形
+	TArray<TArray<FCanvasUVTri>> Triangles;
+
+	// Triangles用的字型 只在Draw裡有效
+	UFont* GlyphFont = nullptr;
+};
@@ -0,0 +1,100 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DamageTable.h"
+#include "BasicUnit.h"
+#include "HeroBuff.h"
+
+namespace
+{
+	// 依傷害類型排列 物理 魔法 真實
+	const EHeroBuffUnique CriticalChanceKey[] = { HEROU::PhysicalCriticalChance, HEROU::MagicalCriticalChance, HEROU::PureCriticalChance };
+	const EHeroBuffUnique CriticalPercentageKey[] = { HEROU::PhysicalCriticalPercentage, HEROU::MagicalCriticalPercentage, HEROU::PureCriticalPercentage };
+	const EHeroBuffUnique BlockingChanceKey[] = { HEROU::BlockingPhysicalChance, HEROU::BlockingMagicalChance, HEROU::BlockingPureChance };
+	const EHeroBuffUnique BlockingConstantKey[] = { HEROU::BlockingPhysicalConstant, HEROU::BlockingMagicalConstant, HEROU::BlockingPureConstant };
+	const EHeroBuffProperty BlockAllKey[] = { HEROP::BlockingPhysical, HEROP::BlockingMagical, HEROP::BlockingPure };
+	const EHeroBuffProperty BlockConstantKey[] = { HEROP::BlockingPhysicalConstant, HEROP::BlockingMagicalConstant, HEROP::BlockingPureConstant };
+	const EHeroBuffProperty AbsorbKey[] = { HEROP::AbsorbPhysicalDamagePercentage, HEROP::AbsorbMagicalDamagePercentage, HEROP::AbsorbPureDamagePercentage };
+	const EHeroBuffProperty OutputKey[] = { HEROP::PhysicalDamageOutputPercentage, HEROP::MagicalDamageOutputPercentage, HEROP::PureDamageOutputPercentage };
+	const EHeroBuffProperty InputKey[] = { HEROP::PhysicalDamageInputPercentage, HEROP::MagicalDamageInputPercentage, HEROP::PureDamageInputPercentage };
+	const EHeroBuffState ImmuneKey[] = { HEROS::PhysicalImmune, HEROS::MagicalImmune, HEROS::PureImmune };
+}
+
+void FDamageTypeTable::Reset()
+{
+	Critical.Reset();
+	Blocking.Reset();
+	BlockAll = 0;
+	BlockConstant = 0;
+	Absorb = 0;
+	Output = 1;
+	Input = 1;
+	Immune = false;
+}
+
+float FDamageTypeTable::RollCritical(float Roll) const
+{
+	// 找第一個累積機率大於Roll的倍率
+	int32 lo = 0;
+	int32 hi = Critical.Num();
+	while (lo < hi)
+	{
+		const int32 mid = (lo + hi) / 2;
+		if (Critical[mid].X > Roll)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+	return lo < Critical.Num() ? Critical[lo].Y : 1.f;
+}
+
+void FUnitDamageTable::Build(const ABasicUnit* Unit)
+{
+	for (int32 t = 0; t < TypeCount; ++t)
+	{
+		FDamageTypeTable& Table = Type[t];
+		Table.Reset();
+		for (AHeroBuff* Buff : Unit->Buffs)
+		{
+			if (!IsValid(Buff))
+			{
+				continue;
+			}
+			// 倍率不到1跟不會發動的不用放
+			const float* Chance = Buff->BuffUniqueMap.Find(CriticalChanceKey[t]);
+			const float Percentage = Buff->BuffUniqueMap.FindRef(CriticalPercentageKey[t]);
+			if (Chance && *Chance > 0 && Percentage > 1)
+			{
+				Table.Critical.Add(FVector2D(FMath::Min(*Chance, 1.f), Percentage));
+			}
+			Chance = Buff->BuffUniqueMap.Find(BlockingChanceKey[t]);
+			if (Chance && *Chance > 0)
+			{
+				Table.Blocking.Add(FVector2D(*Chance, Buff->BuffUniqueMap.FindRef(BlockingConstantKey[t])));
+			}
+		}
+		// 倍率大的先判定 機率改成累積機率
+		Table.Critical.Sort([](const FVector2D& A, const FVector2D& B)
+		{
+			return A.Y > B.Y;
+		});
+		float NoCritical = 1;
+		for (FVector2D& Critical : Table.Critical)
+		{
+			NoCritical *= 1 - Critical.X;
+			Critical.X = 1 - NoCritical;
+		}
+		Table.BlockAll = Unit->GetBuffProperty(BlockAllKey[t]);
+		Table.BlockConstant = Unit->GetBuffProperty(BlockConstantKey[t]);
+		Table.Absorb = Unit->GetBuffProperty(AbsorbKey[t]);
+		Table.Output = Unit->GetBuffProperty(OutputKey[t]);
+		Table.Input = Unit->GetBuffProperty(InputKey[t]);
+		Table.Immune = Unit->HasBuffState(ImmuneKey[t]);
+	}
+	Miss = Unit->GetBuffProperty(HEROP::AttackMiss);
+	Dodge = Unit->GetBuffProperty(HEROP::Dodge);
+	StealHealth = Unit->GetBuffProperty(HEROP::StealHealth);
+}
@@ -0,0 +1,58 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MobaEnum.h"
+
+class ABasicUnit;
+
+// 單一傷害類型結算要用到的數值
+struct AON_API FDamageTypeTable
+{
+	// 各Buff的爆擊 依倍率由大到小 X是累積到這一項的爆擊機率 Y倍率
+	// 每個Buff各自判定取最大倍率 等同於用一個亂數查這張表
+	TArray<FVector2D> Critical;
+	// 各Buff的格檔 X機率 Y格檔量
+	TArray<FVector2D> Blocking;
+	// 完全格檔機率
+	float BlockAll = 0;
+	// 固定格檔量
+	float BlockConstant = 0;
+	// 吸收傷害比例
+	float Absorb = 0;
+	// 輸出加成
+	float Output = 1;
+	// 受到傷害加成
+	float Input = 1;
+	// 免疫
+	bool Immune = false;
+
+	void Reset();
+
+	// 用一個0~1的亂數查爆擊倍率 沒有爆擊回傳1
+	float RollCritical(float Roll) const;
+};
+
+// 一個單位結算傷害用的表 每個傷害類型一份
+// buff有變動時才重建 每次傷害只要查表
+struct AON_API FUnitDamageTable
+{
+	static const int32 TypeCount = (int32)EDamageType::DAMAGE_PURE + 1;
+
+	FDamageTypeTable Type[TypeCount];
+	// 普攻失誤機率
+	float Miss = 0;
+	// 閃避機率
+	float Dodge = 0;
+	// 吸血比例
+	float StealHealth = 0;
+
+	FORCEINLINE const FDamageTypeTable& Get(EDamageType t) const
+	{
+		return Type[(int32)t];
+	}
+
+	// 從單位的Buff跟加總後的數值建表
+	void Build(const ABasicUnit* Unit);
+};
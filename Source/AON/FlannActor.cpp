@@ -2,134 +2,582 @@
 #include "FlannActor.h"
 #include "AON.h"
 #include "BasicUnit.h"
-#include "Algo/Reverse.h"
+#include "EngineUtils.h"
+#include "HeroBuff.h"
+#include "MOBAGameState.h"
 
 
 // Sets default values
 AFlannActor::AFlannActor()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	// The grid is maintained by the units themselves, ticking only refreshes auras
 	PrimaryActorTick.bCanEverTick = true;
-	PrimaryActorTick.TickInterval = 0.05;
-	rdata.SetNumZeroed(MaxActor * 2);
-	qdata1.SetNumZeroed(2);
-	//query1 = flann::Matrix<float>(qdata1.GetData(), 1, 2);
+	PrimaryActorTick.TickInterval = 0.1;
+	Cells.Reserve(MaxActor / 4);
 }
 
 // Called when the game starts or when spawned
 void AFlannActor::BeginPlay()
 {
-	//Super::BeginPlay();
-	
+	Super::BeginPlay();
+	// units that began play before this index was spawned
+	for (TActorIterator<ABasicUnit> ActorItr(GetWorld()); ActorItr; ++ActorItr)
+	{
+		ABasicUnit* unit = *ActorItr;
+		if (unit->HasActorBegunPlay() && !unit->IsPendingKill())
+		{
+			RegisterUnit(unit);
+		}
+	}
 }
 
-// Called every frame
-void AFlannActor::Tick(float DeltaTime)
+void AFlannActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	//Super::Tick(DeltaTime);
-	int32 row = 0;
-	FindArray.Empty();
-	rdata.SetNumZeroed(MaxActor * 2);
-	/*
-	for (TActorIterator<ABasicUnit> ActorItr(GetWorld()); ActorItr; ++ActorItr)
+	for (TPair<FIntPoint, TArray<ABasicUnit*>>& cell : Cells)
 	{
-		ABasicUnit* hero = *ActorItr;
-		FindArray.Add(hero);
-		FVector pos = hero->GetActorLocation();
-		rdata[row * 2 + 0] = pos.X;
-		rdata[row * 2 + 1] = pos.Y;
-		row++;
-		if (row > MaxActor)
+		for (ABasicUnit* unit : cell.Value)
 		{
-			break;
+			if (unit)
+			{
+				unit->InGrid = false;
+			}
 		}
 	}
-	*/
-	if (row > 1)
+	Cells.Empty();
+	UnitCount = 0;
+	for (AHeroBuff* buff : AuraBuffs)
 	{
-		//dataset = flann::Matrix<float>(rdata.GetData(), row, 2);
-		//index = std::shared_ptr<flann::Index<flann::L2<float>>>(
-		//	new flann::Index<flann::L2<float>>(dataset, flann::KDTreeIndexParams(1)));
-		//index->buildIndex();
+		if (buff)
+		{
+			buff->AuraRegistered = false;
+		}
 	}
-	
-	CurrnetRow = row;
+	AuraBuffs.Empty();
+	AuraSubs.Empty();
+	AuraCells.Empty();
+	AuraMovedUnits.Empty();
+	Super::EndPlay(EndPlayReason);
 }
 
-TArray<ABasicUnit*> AFlannActor::FindRadiusActorByLocation(ABasicUnit* hero, FVector Center,
-	float Radius, ETeamFlag flag, bool CheckAlive, std::vector<std::vector<float>>& dists)
+AFlannActor* AFlannActor::Get(const UObject* WorldContextObject)
 {
-	Radius = Radius * Radius;
-	TArray<ABasicUnit*> res;
-	qdata1.SetNumZeroed(2);
-	//query1 = flann::Matrix<float>(qdata1.GetData(), 1, 2);
+	UWorld* world = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	AMOBAGameState* gs = world ? world->GetGameState<AMOBAGameState>() : nullptr;
+	if (gs && IsValid(gs->FlannActor))
+	{
+		return gs->FlannActor;
+	}
+	return nullptr;
+}
 
-	if (CurrnetRow > 1)
+// Called every frame
+void AFlannActor::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	TickAuras();
+}
+
+void AFlannActor::TickAuras()
+{
+	CompactAuras();
+	if (AuraBuffs.Num() == 0)
+	{
+		AuraMovedUnits.Reset();
+		return;
+	}
+	// enter/exit callbacks may unregister auras, indices have to stay put until the end
+	TickingAuras = true;
+	// auras whose source moved or radius changed get a full query
+	AuraQueries.Reset();
+	AuraQueryFirst.Reset();
+	AuraRequeryIndex.Reset();
+	AuraRequeried.Init(false, AuraBuffs.Num());
+	for (int32 i = 0; i < AuraBuffs.Num(); ++i)
 	{
-		qdata1[0] = Center.X;
-		qdata1[1] = Center.Y;
-		//index->radiusSearch(query1, indices, dists, Radius, flann::SearchParams(32, 0, true));
-		for (int& idx : indices[0])
+		AHeroBuff* buff = AuraBuffs[i];
+		if (!IsValid(buff))
 		{
-			ABasicUnit* target = FindArray[idx];
-			if (CheckAlive && !target->IsAlive)
-			{
-				continue;
-			}
-			if (flag == ETeamFlag::TeamEnemy && hero->TeamId != target->TeamId)
-			{
-				res.Add(target);
-			}
-			else if (flag == ETeamFlag::TeamFriends && hero->TeamId == target->TeamId)
-			{
-				res.Add(target);
-			}
-			else if (flag == ETeamFlag::Team1 && target->TeamId == 1)
-			{
-				res.Add(target);
-			}
-			else if (flag == ETeamFlag::Team2 && target->TeamId == 2)
+			continue;
+		}
+		FAuraSubscription& sub = AuraSubs[i];
+		FAuraSubscription now;
+		now.Active = buff->GetAuraShape(now.Center, now.RadiusEnemy, now.RadiusFriends);
+		if (!now.Active)
+		{
+			// same as before: an inactive aura keeps its targets untouched
+			if (sub.Active)
 			{
-				res.Add(target);
+				sub.Active = false;
+				AuraCellsDirty = true;
 			}
-			else if (flag == ETeamFlag::TeamAll)
+			continue;
+		}
+		if (sub.Active && now.Center == sub.Center && now.RadiusEnemy == sub.RadiusEnemy
+			&& now.RadiusFriends == sub.RadiusFriends)
+		{
+			continue;
+		}
+		const float radius = FMath::Max(now.RadiusEnemy, now.RadiusFriends);
+		now.MinCell = ToCell(now.Center - FVector(radius, radius, 0));
+		now.MaxCell = ToCell(now.Center + FVector(radius, radius, 0));
+		if (!sub.Active || now.MinCell != sub.MinCell || now.MaxCell != sub.MaxCell)
+		{
+			AuraCellsDirty = true;
+		}
+		sub = now;
+		AuraRequeried[i] = true;
+		AuraRequeryIndex.Add(i);
+		AuraQueryFirst.Add(AuraQueries.Num());
+		buff->AppendAuraQueries(AuraQueries);
+	}
+	AuraQueryFirst.Add(AuraQueries.Num());
+	if (AuraQueries.Num() > 0)
+	{
+		FindRadiusActorsBatch(AuraQueries, AuraResults);
+	}
+	for (int32 k = 0; k < AuraRequeryIndex.Num(); ++k)
+	{
+		const int32 first = AuraQueryFirst[k];
+		const int32 last = AuraQueryFirst[k + 1];
+		if (first == last)
+		{
+			continue;
+		}
+		// queries of one buff are adjacent, so are their results
+		const int32 start = AuraQueries[first].ResultStart;
+		const int32 num = AuraQueries[last - 1].ResultStart + AuraQueries[last - 1].ResultNum - start;
+		AHeroBuff* buff = AuraBuffs[AuraRequeryIndex[k]];
+		if (IsValid(buff))
+		{
+			buff->UpdateAuraTargets(TArrayView<ABasicUnit*>(AuraResults.GetData() + start, num));
+		}
+	}
+	if (AuraCellsDirty)
+	{
+		RebuildAuraCells();
+	}
+	// everything else only sees the units that moved, died or spawned
+	for (const TPair<ABasicUnit*, FIntPoint>& moved : AuraMovedUnits)
+	{
+		ABasicUnit* unit = moved.Key;
+		CheckAuraCell(unit, moved.Value);
+		if (unit->InGrid && unit->GridCell != moved.Value)
+		{
+			CheckAuraCell(unit, unit->GridCell);
+		}
+	}
+	AuraMovedUnits.Reset();
+	TickingAuras = false;
+	// auras unregistered during the pass were only nulled
+	CompactAuras();
+}
+
+void AFlannActor::CompactAuras()
+{
+	for (int32 i = AuraBuffs.Num() - 1; i >= 0; --i)
+	{
+		if (!IsValid(AuraBuffs[i]))
+		{
+			AuraBuffs.RemoveAtSwap(i, 1, false);
+			AuraSubs.RemoveAtSwap(i, 1, false);
+			AuraCellsDirty = true;
+		}
+	}
+}
+
+void AFlannActor::RebuildAuraCells()
+{
+	AuraCellsDirty = false;
+	AuraCells.Reset();
+	for (int32 i = 0; i < AuraSubs.Num(); ++i)
+	{
+		const FAuraSubscription& sub = AuraSubs[i];
+		if (!sub.Active)
+		{
+			continue;
+		}
+		for (int32 cx = sub.MinCell.X; cx <= sub.MaxCell.X; ++cx)
+		{
+			for (int32 cy = sub.MinCell.Y; cy <= sub.MaxCell.Y; ++cy)
 			{
-				res.Add(target);
+				AuraCells.FindOrAdd(FIntPoint(cx, cy)).Add(i);
 			}
 		}
-		indices.clear();
 	}
-	else if (CurrnetRow == 1)
+}
+
+void AFlannActor::CheckAuraCell(ABasicUnit* unit, const FIntPoint& cell)
+{
+	const TArray<int32>* auras = AuraCells.Find(cell);
+	if (!auras)
+	{
+		return;
+	}
+	for (int32 aura : *auras)
+	{
+		if (!AuraRequeried[aura])
+		{
+			CheckAura(unit, aura);
+		}
+	}
+}
+
+void AFlannActor::CheckAura(ABasicUnit* unit, int32 aura)
+{
+	AHeroBuff* buff = AuraBuffs[aura];
+	const FAuraSubscription& sub = AuraSubs[aura];
+	if (!sub.Active || !IsValid(buff) || !IsValid(buff->BuffTargetOne))
+	{
+		return;
+	}
+	ABasicUnit* source = buff->BuffTargetOne;
+	// same test as the batched query with CheckAlive
+	bool inside = false;
+	if (unit->InGrid && unit->IsAlive)
+	{
+		const float d2 = FVector::DistSquared2D(unit->GetActorLocation(), sub.Center);
+		inside = (sub.RadiusEnemy >= 0 && d2 <= sub.RadiusEnemy * sub.RadiusEnemy
+				&& MatchTeam(source, unit, ETeamFlag::TeamEnemy))
+			|| (sub.RadiusFriends >= 0 && d2 <= sub.RadiusFriends * sub.RadiusFriends
+				&& MatchTeam(source, unit, ETeamFlag::TeamFriends));
+	}
+	const bool member = buff->BuffTarget.Contains(unit);
+	if (inside && !member)
+	{
+		buff->OnAuraEnter(unit);
+	}
+	else if (!inside && member)
+	{
+		buff->OnAuraExit(unit);
+	}
+}
+
+void AFlannActor::MarkAuraUnit(ABasicUnit* unit)
+{
+	if (AuraBuffs.Num() > 0 && !AuraMovedUnits.Contains(unit))
+	{
+		AuraMovedUnits.Add(unit, unit->GridCell);
+	}
+}
+
+void AFlannActor::DropAuraUnit(ABasicUnit* unit)
+{
+	AuraMovedUnits.Remove(unit);
+	for (AHeroBuff* buff : AuraBuffs)
+	{
+		if (IsValid(buff))
+		{
+			buff->BuffTarget.Remove(unit);
+		}
+	}
+}
+
+void AFlannActor::RegisterAura(AHeroBuff* buff)
+{
+	if (!AuraBuffs.Contains(buff))
+	{
+		AuraBuffs.Add(buff);
+		// inactive until the next pass queries it
+		AuraSubs.AddDefaulted();
+	}
+}
+
+void AFlannActor::UnregisterAura(AHeroBuff* buff)
+{
+	const int32 idx = AuraBuffs.Find(buff);
+	if (idx != INDEX_NONE && TickingAuras)
+	{
+		// the pass still uses the indices, compacted when it ends
+		AuraBuffs[idx] = nullptr;
+		AuraSubs[idx].Active = false;
+	}
+	else if (idx != INDEX_NONE)
+	{
+		AuraBuffs.RemoveAtSwap(idx, 1, false);
+		AuraSubs.RemoveAtSwap(idx, 1, false);
+		AuraCellsDirty = true;
+	}
+}
+
+void AFlannActor::RegisterUnit(ABasicUnit* unit)
+{
+	if (unit->InGrid)
+	{
+		return;
+	}
+	unit->GridCell = ToCell(unit->GetActorLocation());
+	unit->InGrid = true;
+	Cells.FindOrAdd(unit->GridCell).Add(unit);
+	UnitCount++;
+	MarkAuraUnit(unit);
+}
+
+void AFlannActor::UnregisterUnit(ABasicUnit* unit)
+{
+	// dying units leave their auras on the next pass, destroyed ones right away
+	if (unit->IsPendingKillPending())
+	{
+		DropAuraUnit(unit);
+	}
+	else if (unit->InGrid)
+	{
+		MarkAuraUnit(unit);
+	}
+	if (!unit->InGrid)
+	{
+		return;
+	}
+	TArray<ABasicUnit*>* cell = Cells.Find(unit->GridCell);
+	if (cell)
+	{
+		cell->RemoveSingleSwap(unit, false);
+	}
+	unit->InGrid = false;
+	UnitCount--;
+}
+
+void AFlannActor::UpdateUnit(ABasicUnit* unit)
+{
+	if (!unit->InGrid)
+	{
+		return;
+	}
+	MarkAuraUnit(unit);
+	FIntPoint cell = ToCell(unit->GetActorLocation());
+	if (cell == unit->GridCell)
+	{
+		return;
+	}
+	TArray<ABasicUnit*>* old = Cells.Find(unit->GridCell);
+	if (old)
+	{
+		old->RemoveSingleSwap(unit, false);
+	}
+	unit->GridCell = cell;
+	Cells.FindOrAdd(cell).Add(unit);
+}
+
+bool AFlannActor::MatchTeam(ABasicUnit* hero, ABasicUnit* target, ETeamFlag flag)
+{
+	switch (flag)
+	{
+	case ETeamFlag::TeamEnemy:
+		return hero && hero->TeamId != target->TeamId;
+	case ETeamFlag::TeamFriends:
+		return hero && hero->TeamId == target->TeamId;
+	case ETeamFlag::Team1:
+		return target->TeamId == 1;
+	case ETeamFlag::Team2:
+		return target->TeamId == 2;
+	case ETeamFlag::TeamAll:
+		return true;
+	}
+	return false;
+}
+
+void AFlannActor::GatherCell(const FIntPoint& cell, const FVector& Center, float RadiusSquared,
+	TArray<FCandidate>& Out) const
+{
+	const TArray<ABasicUnit*>* units = Cells.Find(cell);
+	if (!units)
+	{
+		return;
+	}
+	for (ABasicUnit* unit : *units)
+	{
+		const float d2 = FVector::DistSquared2D(unit->GetActorLocation(), Center);
+		if (d2 <= RadiusSquared)
+		{
+			Out.Add({ unit, d2 });
+		}
+	}
+}
+
+TArray<ABasicUnit*> AFlannActor::FindRadiusActorByLocation(ABasicUnit* hero, FVector Center,
+	float Radius, ETeamFlag flag, bool CheckAlive, TArray<float>* OutDistSquared)
+{
+	TArray<ABasicUnit*> res;
+	if (OutDistSquared)
+	{
+		OutDistSquared->Reset();
+	}
+	if (UnitCount == 0 || Radius < 0 || !IsValid(hero))
 	{
-		ABasicUnit* target = FindArray[0];
-		if (FVector::DistSquared2D(target->GetTargetLocation(), Center) < Radius)
+		return res;
+	}
+	Candidates.Reset();
+	const float RadiusSquared = Radius * Radius;
+	const FIntPoint lo = ToCell(Center - FVector(Radius, Radius, 0));
+	const FIntPoint hi = ToCell(Center + FVector(Radius, Radius, 0));
+	for (int32 cx = lo.X; cx <= hi.X; ++cx)
+	{
+		for (int32 cy = lo.Y; cy <= hi.Y; ++cy)
+		{
+			GatherCell(FIntPoint(cx, cy), Center, RadiusSquared, Candidates);
+		}
+	}
+	// farthest first, nearest last (callers take Last())
+	Candidates.Sort([](const FCandidate& a, const FCandidate& b)
+	{
+		return a.DistSquared > b.DistSquared;
+	});
+	res.Reserve(Candidates.Num());
+	for (const FCandidate& c : Candidates)
+	{
+		ABasicUnit* target = c.Unit;
+		if ((CheckAlive && !target->IsAlive) || !MatchTeam(hero, target, flag))
 		{
-			if (CheckAlive && !target->IsAlive)
+			continue;
+		}
+		res.Add(target);
+		if (OutDistSquared)
+		{
+			OutDistSquared->Add(c.DistSquared);
+		}
+	}
+	return res;
+}
+
+void AFlannActor::FindRadiusActorsBatch(TArray<FRadiusQuery>& Queries, TArray<ABasicUnit*>& OutUnits)
+{
+	OutUnits.Reset();
+	BatchCells.Reset();
+	BatchHits.Reset();
+	for (int32 q = 0; q < Queries.Num(); ++q)
+	{
+		FRadiusQuery& query = Queries[q];
+		query.ResultStart = 0;
+		query.ResultNum = 0;
+		if (!IsValid(query.Hero) || query.Radius < 0)
+		{
+			continue;
+		}
+		const FVector ext(query.Radius, query.Radius, 0);
+		const FIntPoint lo = ToCell(query.Center - ext);
+		const FIntPoint hi = ToCell(query.Center + ext);
+		for (int32 cx = lo.X; cx <= hi.X; ++cx)
+		{
+			for (int32 cy = lo.Y; cy <= hi.Y; ++cy)
 			{
+				BatchCells.Add({ FIntPoint(cx, cy), q });
 			}
-			else if (flag == ETeamFlag::TeamEnemy && hero->TeamId != target->TeamId)
+		}
+	}
+	// group by cell so each cell is looked up and walked once for all queries touching it
+	BatchCells.Sort([](const FCellQuery& a, const FCellQuery& b)
+	{
+		return a.Cell.X != b.Cell.X ? a.Cell.X < b.Cell.X : a.Cell.Y < b.Cell.Y;
+	});
+	for (int32 i = 0; i < BatchCells.Num();)
+	{
+		int32 end = i + 1;
+		while (end < BatchCells.Num() && BatchCells[end].Cell == BatchCells[i].Cell)
+		{
+			end++;
+		}
+		const TArray<ABasicUnit*>* units = Cells.Find(BatchCells[i].Cell);
+		if (units)
+		{
+			for (ABasicUnit* unit : *units)
 			{
-				res.Add(target);
+				const FVector pos = unit->GetActorLocation();
+				for (int32 k = i; k < end; ++k)
+				{
+					const FRadiusQuery& query = Queries[BatchCells[k].Query];
+					const float d2 = FVector::DistSquared2D(pos, query.Center);
+					if (d2 <= query.Radius * query.Radius && (!query.CheckAlive || unit->IsAlive)
+						&& MatchTeam(query.Hero, unit, query.Flag))
+					{
+						BatchHits.Add({ BatchCells[k].Query, d2, unit });
+					}
+				}
 			}
-			else if (flag == ETeamFlag::TeamFriends && hero->TeamId == target->TeamId)
+		}
+		i = end;
+	}
+	// by query, then farthest first like FindRadiusActorByLocation
+	BatchHits.Sort([](const FBatchHit& a, const FBatchHit& b)
+	{
+		return a.Query != b.Query ? a.Query < b.Query : a.DistSquared > b.DistSquared;
+	});
+	OutUnits.Reserve(BatchHits.Num());
+	for (const FBatchHit& hit : BatchHits)
+	{
+		FRadiusQuery& query = Queries[hit.Query];
+		if (query.ResultNum == 0)
+		{
+			query.ResultStart = OutUnits.Num();
+		}
+		query.ResultNum++;
+		OutUnits.Add(hit.Unit);
+	}
+	// keep empty spans pointing at a valid position
+	int32 next = 0;
+	for (FRadiusQuery& query : Queries)
+	{
+		if (query.ResultNum == 0)
+		{
+			query.ResultStart = next;
+		}
+		next = query.ResultStart + query.ResultNum;
+	}
+}
+
+TArray<ABasicUnit*> AFlannActor::FindNearestActorByLocation(ABasicUnit* hero, FVector Center,
+	int32 Count, float MaxRadius, ETeamFlag flag, bool CheckAlive)
+{
+	TArray<ABasicUnit*> res;
+	if (UnitCount == 0 || Count <= 0 || MaxRadius < 0 || !IsValid(hero))
+	{
+		return res;
+	}
+	Candidates.Reset();
+	const float RadiusSquared = MaxRadius * MaxRadius;
+	const FIntPoint cc = ToCell(Center);
+	const int32 maxRing = FMath::CeilToInt(MaxRadius / CellSize) + 1;
+	// walk rings outward, stop once the Count-th hit is closer than the next ring
+	for (int32 ring = 0; ring <= maxRing; ++ring)
+	{
+		const int32 before = Candidates.Num();
+		for (int32 cx = cc.X - ring; cx <= cc.X + ring; ++cx)
+		{
+			const bool edge = (cx == cc.X - ring || cx == cc.X + ring);
+			for (int32 cy = cc.Y - ring; cy <= cc.Y + ring; cy += (edge || ring == 0) ? 1 : ring * 2)
 			{
-				res.Add(target);
+				GatherCell(FIntPoint(cx, cy), Center, RadiusSquared, Candidates);
 			}
-			else if (flag == ETeamFlag::Team1 && target->TeamId == 1)
+		}
+		for (int32 i = Candidates.Num() - 1; i >= before; --i)
+		{
+			ABasicUnit* target = Candidates[i].Unit;
+			if ((CheckAlive && !target->IsAlive) || !MatchTeam(hero, target, flag))
 			{
-				res.Add(target);
+				Candidates.RemoveAtSwap(i, 1, false);
 			}
-			else if (flag == ETeamFlag::Team2 && target->TeamId == 2)
+		}
+		if (Candidates.Num() >= Count)
+		{
+			Candidates.Sort([](const FCandidate& a, const FCandidate& b)
 			{
-				res.Add(target);
-			}
-			else if (flag == ETeamFlag::TeamAll)
+				return a.DistSquared < b.DistSquared;
+			});
+			Candidates.SetNum(Count, false);
+			const float ringDist = ring * CellSize;
+			if (Candidates.Last().DistSquared <= ringDist * ringDist)
 			{
-				res.Add(target);
+				break;
 			}
 		}
 	}
-	Algo::Reverse(res);
+	Candidates.Sort([](const FCandidate& a, const FCandidate& b)
+	{
+		return a.DistSquared > b.DistSquared;
+	});
+	res.Reserve(Candidates.Num());
+	for (const FCandidate& c : Candidates)
+	{
+		res.Add(c.Unit);
+	}
 	return res;
 }
 
@@ -137,7 +585,7 @@ void AFlannActor::Resize(int32 maxActor, int32 maxQuery)
 {
 	MaxActor = maxActor;
 	MaxQuery = maxQuery;
-	rdata.SetNumZeroed(MaxActor * 2);
+	Cells.Reserve(MaxActor / 4);
 }
 
 
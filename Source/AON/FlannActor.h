@@ -5,8 +5,6 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "HeroCharacter.h"
-#include <memory>
-#include <vector>
 #include "FlannActor.generated.h"
 
 
@@ -28,6 +26,36 @@ struct FLZ4
 	int32 OriginStringSize;
 };
 
+class AHeroBuff;
+
+// One request of a batched radius search, ResultStart/ResultNum index the shared result array
+USTRUCT(BlueprintType)
+struct FRadiusQuery
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ABasicUnit* Hero = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Center = FVector::ZeroVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float Radius = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ETeamFlag Flag = ETeamFlag::TeamAll;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool CheckAlive = true;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 ResultStart = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 ResultNum = 0;
+};
+
 UCLASS()
 class AON_API AFlannActor : public AActor
 {
@@ -43,26 +71,132 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	// Releases the units so a later index can register them again
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// The index of the world's game state, null if there is none yet
+	static AFlannActor* Get(const UObject* WorldContextObject);
+
+	// Unit registry, cells only change when a unit crosses a cell border.
+	// Dead units stay registered, queries drop them through CheckAlive.
+	void RegisterUnit(ABasicUnit* unit);
+	void UnregisterUnit(ABasicUnit* unit);
+	void UpdateUnit(ABasicUnit* unit);
+
+	// Units inside Radius (2D), sorted farthest first so the nearest one is Last().
+	// OutDistSquared, when given, receives the matching squared distances.
+	// An invalid hero returns nothing.
 	TArray<ABasicUnit*> FindRadiusActorByLocation(ABasicUnit* hero, FVector Center,
-		float Radius, ETeamFlag flag, bool CheckAlive, std::vector<std::vector<float>>& dists);
+		float Radius, ETeamFlag flag, bool CheckAlive, TArray<float>* OutDistSquared = nullptr);
+
+	// Up to Count nearest units inside MaxRadius (2D), same ordering as the radius query.
+	TArray<ABasicUnit*> FindNearestActorByLocation(ABasicUnit* hero, FVector Center,
+		int32 Count, float MaxRadius, ETeamFlag flag, bool CheckAlive);
+
+	// Runs all queries in one pass over the grid. Results are appended to OutUnits
+	// (caller owned, Reset but not freed), each query gets its span, farthest first.
+	void FindRadiusActorsBatch(TArray<FRadiusQuery>& Queries, TArray<ABasicUnit*>& OutUnits);
+
+	// Aura buffs subscribe here. A subscription is only re-queried when its source
+	// moves or its radius changes; other units are checked against the auras
+	// covering their cell when they move, and the buff gets enter/exit calls.
+	void RegisterAura(AHeroBuff* buff);
+	void UnregisterAura(AHeroBuff* buff);
+
+	// Enemy/friend flags need a hero, a null hero matches nothing for them
+	static bool MatchTeam(ABasicUnit* hero, ABasicUnit* target, ETeamFlag flag);
 
 	void Resize(int32 maxActor, int32 maxQuery);
 
 	static FLZ4 Compress(FString data);
 	FString Decompress(FLZ4 flz4);
 
+	// Edge length of one grid cell in world units
+	float CellSize = 500.f;
+
 private:
-	TArray<ABasicUnit*> FindArray;
+	struct FCandidate
+	{
+		ABasicUnit* Unit;
+		float DistSquared;
+	};
+
+	FORCEINLINE FIntPoint ToCell(const FVector& pos) const
+	{
+		return FIntPoint(FMath::FloorToInt(pos.X / CellSize), FMath::FloorToInt(pos.Y / CellSize));
+	}
+
+	// Appends every unit of cell within RadiusSquared of Center to Out
+	void GatherCell(const FIntPoint& cell, const FVector& Center, float RadiusSquared, TArray<FCandidate>& Out) const;
+
+	struct FAuraSubscription
+	{
+		FVector Center = FVector::ZeroVector;
+		float RadiusEnemy = -1;
+		float RadiusFriends = -1;
+		// cells covered by the larger radius
+		FIntPoint MinCell = FIntPoint::ZeroValue;
+		FIntPoint MaxCell = FIntPoint::ZeroValue;
+		bool Active = false;
+	};
+
+	// Queues a unit for the next aura pass, keeping the cell it was last checked in
+	void MarkAuraUnit(ABasicUnit* unit);
+
+	// Forgets a destroyed unit without calling back into it
+	void DropAuraUnit(ABasicUnit* unit);
+
+	// Enter/exit for one unit against every aura covering cell
+	void CheckAuraCell(ABasicUnit* unit, const FIntPoint& cell);
+
+	void CheckAura(ABasicUnit* unit, int32 aura);
+
+	void RebuildAuraCells();
+
+	void TickAuras();
+
+	// Removes auras that were destroyed or unregistered during a pass
+	void CompactAuras();
+
 	int32 MaxActor = 10000;
 	int32 MaxQuery = 1000;
-	int32 CurrnetRow = 0;
-
-	//flann::Matrix<float> dataset;
-	//flann::Matrix<float> query1;
-	std::vector<std::vector<int>> indices;
-	//std::shared_ptr<flann::Index<flann::L2<float>>> index;
+	int32 UnitCount = 0;
+
+	// Persistent bucketed grid, cell -> units inside it
+	TMap<FIntPoint, TArray<ABasicUnit*>> Cells;
+
+	TArray<FCandidate> Candidates;
+
+	// batch scratch, kept between calls to avoid allocations
+	struct FCellQuery
+	{
+		FIntPoint Cell;
+		int32 Query;
+	};
+	struct FBatchHit
+	{
+		int32 Query;
+		float DistSquared;
+		ABasicUnit* Unit;
+	};
+	TArray<FCellQuery> BatchCells;
+	TArray<FBatchHit> BatchHits;
 
-	TArray<float>	rdata;
-	TArray<float>	qdata1;
+	UPROPERTY()
+	TArray<AHeroBuff*> AuraBuffs;
+	// same index as AuraBuffs
+	TArray<FAuraSubscription> AuraSubs;
+	// cell -> indices of the auras covering it
+	TMap<FIntPoint, TArray<int32>> AuraCells;
+	bool AuraCellsDirty = false;
+	// set during TickAuras, UnregisterAura only nulls the slot then
+	bool TickingAuras = false;
+	// units moved since the last aura pass -> cell they were last checked in
+	TMap<ABasicUnit*, FIntPoint> AuraMovedUnits;
+	// auras re-queried this pass, moved units skip them
+	TBitArray<> AuraRequeried;
+	TArray<int32> AuraRequeryIndex;
+	TArray<FRadiusQuery> AuraQueries;
+	TArray<int32> AuraQueryFirst;
+	TArray<ABasicUnit*> AuraResults;
 };
-
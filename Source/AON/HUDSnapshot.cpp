@@ -0,0 +1,357 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HUDSnapshot.h"
+#include "BasicUnit.h"
+#include "HeroCharacter.h"
+#include "HeroSkill.h"
+#include "HeroBuff.h"
+
+namespace
+{
+	// 整數欄位跟原本json的SetInteger一樣捨去小數 回血時不會每個Frame都變
+	FORCEINLINE float Trunc(float v)
+	{
+		return FMath::TruncToFloat(v);
+	}
+
+	// 倒數類的欄位只要到0.1秒
+	FORCEINLINE float Tenth(float v)
+	{
+		return FMath::FloorToFloat(v * 10.f) * 0.1f;
+	}
+
+	FORCEINLINE uint32 HashFloat(uint32 Hash, float v)
+	{
+		return HashCombine(Hash, GetTypeHash(Trunc(v)));
+	}
+
+	void AppendJsonString(FString& Out, const FString& Value)
+	{
+		Out.AppendChar(TEXT('"'));
+		for (const TCHAR c : Value)
+		{
+			switch (c)
+			{
+			case TEXT('"'):
+				Out.Append(TEXT("\\\""));
+				break;
+			case TEXT('\\'):
+				Out.Append(TEXT("\\\\"));
+				break;
+			case TEXT('\n'):
+				Out.Append(TEXT("\\n"));
+				break;
+			case TEXT('\r'):
+				Out.Append(TEXT("\\r"));
+				break;
+			case TEXT('\t'):
+				Out.Append(TEXT("\\t"));
+				break;
+			default:
+				if (c < 0x20 || c == 0x2028 || c == 0x2029)
+				{
+					Out += FString::Printf(TEXT("\\u%04x"), (uint32)c);
+				}
+				else
+				{
+					Out.AppendChar(c);
+				}
+				break;
+			}
+		}
+		Out.AppendChar(TEXT('"'));
+	}
+
+	void AppendJsonField(FString& Out, const TCHAR* Key, const FString& Value)
+	{
+		if (Out[Out.Len() - 1] != TEXT('{'))
+		{
+			Out.AppendChar(TEXT(','));
+		}
+		Out.AppendChar(TEXT('"'));
+		Out.Append(Key);
+		Out.Append(TEXT("\":"));
+		AppendJsonString(Out, Value);
+	}
+
+	// 跟上次不同的欄位 上次比較多的話多出來的送空字串讓網頁清掉
+	bool AppendArrayPatch(FString& Out, const TArray<FString>& Values, const TArray<FString>& Last,
+		const FString& (*Key)(int32))
+	{
+		bool Changed = false;
+		const int32 Count = FMath::Max(Values.Num(), Last.Num());
+		for (int32 i = 0; i < Count; ++i)
+		{
+			const FString& Value = Values.IsValidIndex(i) ? Values[i] : FString();
+			const FString& LastValue = Last.IsValidIndex(i) ? Last[i] : FString();
+			if (!Value.Equals(LastValue, ESearchCase::CaseSensitive))
+			{
+				AppendJsonField(Out, *Key(i), Value);
+				Changed = true;
+			}
+		}
+		return Changed;
+	}
+
+	// key只在第一次用到那一格時產生 之後重複使用
+	const FString& CachedKey(TArray<FString>& Keys, int32 Index, const TCHAR* Prefix, const TCHAR** Names, int32 NameCount)
+	{
+		while (Keys.Num() <= Index)
+		{
+			const int32 i = Keys.Num();
+			Keys.Add(FString::Printf(TEXT("%s%d_%s"), Prefix, i / NameCount + 1, Names[i % NameCount]));
+		}
+		return Keys[Index];
+	}
+}
+
+void FUnitHUDSnapshot::Capture(ABasicUnit* Unit)
+{
+	Reset();
+	if (!IsValid(Unit))
+	{
+		return;
+	}
+	Set(EHUDUnitField::TeamId, Unit->TeamId);
+	Set(EHUDUnitField::IsAlive, Unit->IsAlive);
+	Set(EHUDUnitField::CurrentMoveSpeed, Trunc(Unit->CurrentMoveSpeed));
+	Set(EHUDUnitField::CurrentMaxHP, Trunc(Unit->CurrentMaxHP));
+	Set(EHUDUnitField::CurrentHP, Trunc(Unit->CurrentHP));
+	Set(EHUDUnitField::CurrentShield, Trunc(Unit->CurrentShield));
+	Set(EHUDUnitField::CurrentShieldPhysical, Trunc(Unit->CurrentShieldPhysical));
+	Set(EHUDUnitField::CurrentShieldMagical, Trunc(Unit->CurrentShieldMagical));
+	Set(EHUDUnitField::CurrentMaxMP, Trunc(Unit->CurrentMaxMP));
+	Set(EHUDUnitField::CurrentMP, Trunc(Unit->CurrentMP));
+	Set(EHUDUnitField::CurrentRegenHP, Unit->CurrentRegenHP);
+	Set(EHUDUnitField::CurrentRegenMP, Unit->CurrentRegenMP);
+	Set(EHUDUnitField::CurrentAttackSpeed, Unit->CurrentAttackSpeed);
+	Set(EHUDUnitField::CurrentAttackSpeedSecond, Unit->CurrentAttackSpeedSecond);
+	Set(EHUDUnitField::CurrentAttack, Trunc(Unit->CurrentAttack));
+	Set(EHUDUnitField::CurrentArmor, Unit->CurrentArmor);
+	Set(EHUDUnitField::CurrentAttackRange, Trunc(Unit->CurrentAttackRange));
+	Set(EHUDUnitField::CurrentMagicInjured, Unit->CurrentMagicInjured);
+	Set(EHUDUnitField::CurrentSkillIndex, Unit->CurrentSkillIndex);
+	Set(EHUDUnitField::CurrentSkillPoints, Unit->CurrentSkillPoints);
+	Set(EHUDUnitField::StunningLeftCounting, Trunc(Unit->StunningLeftCounting));
+	Set(EHUDUnitField::BountyGold, Unit->BountyGold);
+	Set(EHUDUnitField::BaseAttack, Trunc(Unit->BaseAttack));
+	Set(EHUDUnitField::BaseArmor, Unit->BaseArmor);
+	Set(EHUDUnitField::BaseMoveSpeed, Trunc(Unit->BaseMoveSpeed));
+	Set(EHUDUnitField::BaseAttackRange, Trunc(Unit->BaseAttackRange));
+	Set(EHUDUnitField::Skill_Amount, Unit->Skills.Num());
+	Set(EHUDUnitField::Buff_Amount, Unit->Buffs.Num());
+	if (AHeroCharacter* Hero = Cast<AHeroCharacter>(Unit))
+	{
+		Set(EHUDUnitField::AdditionStrength, Trunc(Hero->AdditionStrength));
+		Set(EHUDUnitField::AdditionAgility, Trunc(Hero->AdditionAgility));
+		Set(EHUDUnitField::AdditionIntelligence, Trunc(Hero->AdditionIntelligence));
+		Set(EHUDUnitField::DeadTime, Trunc(Hero->DeadTime));
+		Set(EHUDUnitField::BountyEXP, Hero->BountyEXP);
+		Set(EHUDUnitField::Strength, Trunc(Hero->Strength));
+		Set(EHUDUnitField::Agility, Trunc(Hero->Agility));
+		Set(EHUDUnitField::Intelligence, Trunc(Hero->Intelligence));
+		Set(EHUDUnitField::CurrentLevel, Hero->CurrentLevel);
+		Set(EHUDUnitField::CurrentEXP, Hero->CurrentEXP);
+	}
+	uint32 Signature = PointerHash(Unit);
+	SkillValues.AddZeroed(Unit->Skills.Num() * SkillFieldCount);
+	BuffValues.AddZeroed(Unit->Buffs.Num() * BuffFieldCount);
+	for (int32 i = 0; i < Unit->Skills.Num(); ++i)
+	{
+		AHeroSkill* Skill = Unit->Skills[i];
+		if (!IsValid(Skill))
+		{
+			continue;
+		}
+		SetSkill(i, EHUDSkillField::Enabled, Skill->IsEnable());
+		SetSkill(i, EHUDSkillField::Toggle, Skill->Toggle);
+		SetSkill(i, EHUDSkillField::Display, Skill->IsDisplay());
+		// 圓餅圖1%一格就夠了
+		SetSkill(i, EHUDSkillField::CDPercent, FMath::FloorToFloat(Skill->GetSkillCDPercent() * 100.f) * 0.01f);
+		SetSkill(i, EHUDSkillField::CurrentCD, Tenth(Skill->GetCurrentCD()));
+		SetSkill(i, EHUDSkillField::MaxCD, Skill->MaxCD);
+		SetSkill(i, EHUDSkillField::CanLevelUp, Skill->CanLevelUp() && Unit->CurrentSkillPoints > 0);
+		SetSkill(i, EHUDSkillField::CurrentLevel, Skill->CurrentLevel);
+		SetSkill(i, EHUDSkillField::MaxLevel, Skill->MaxLevel);
+		Signature = HashCombine(Signature, PointerHash(Skill));
+		Signature = HashCombine(Signature, GetTypeHash(Skill->CurrentLevel));
+	}
+	for (int32 i = 0; i < Unit->Buffs.Num(); ++i)
+	{
+		AHeroBuff* Buff = Unit->Buffs[i];
+		if (!IsValid(Buff))
+		{
+			continue;
+		}
+		SetBuff(i, EHUDBuffField::Friendly, Buff->Friendly);
+		SetBuff(i, EHUDBuffField::Stacks, Buff->Stacks);
+		SetBuff(i, EHUDBuffField::Duration, Tenth(Buff->GetDuration()));
+		SetBuff(i, EHUDBuffField::MaxDuration, Buff->MaxDuration);
+		SetBuff(i, EHUDBuffField::CanStacks, Buff->CanStacks);
+		Signature = HashCombine(Signature, PointerHash(Buff));
+	}
+	// 技能描述會用到的屬性
+	Signature = HashFloat(Signature, Unit->CurrentAttack);
+	Signature = HashFloat(Signature, Unit->BaseAttack);
+	Signature = HashFloat(Signature, Unit->CurrentMoveSpeed);
+	Signature = HashFloat(Signature, Unit->CurrentArmor);
+	Signature = HashFloat(Signature, Unit->BaseArmor);
+	for (int32 f = (int32)EHUDUnitField::AdditionStrength; f < UnitFieldCount; ++f)
+	{
+		Signature = HashFloat(Signature, UnitValues[f]);
+	}
+	TextSignature = Signature;
+
+	const uint16 SkillCount = (uint16)FMath::Min(Unit->Skills.Num(), (int32)MAX_uint16);
+	const uint16 BuffCount = (uint16)FMath::Min(Unit->Buffs.Num(), (int32)MAX_uint16);
+	if (SkillCount != Unit->Skills.Num() || BuffCount != Unit->Buffs.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FUnitHUDSnapshot %s has too many skills(%d) or buffs(%d)"),
+			*Unit->GetName(), Unit->Skills.Num(), Unit->Buffs.Num());
+	}
+	Bytes.Append(reinterpret_cast<const uint8*>(&SkillCount), sizeof(SkillCount));
+	Bytes.Append(reinterpret_cast<const uint8*>(&BuffCount), sizeof(BuffCount));
+	Encode(UnitValues, UnitFieldCount, UnitBoolFields);
+	for (int32 i = 0; i < SkillCount; ++i)
+	{
+		Encode(&SkillValues[i * SkillFieldCount], SkillFieldCount, SkillBoolFields);
+	}
+	for (int32 i = 0; i < BuffCount; ++i)
+	{
+		Encode(&BuffValues[i * BuffFieldCount], BuffFieldCount, BuffBoolFields);
+	}
+}
+
+void FUnitHUDSnapshot::Encode(const float* Values, int32 Count, uint64 BoolFields)
+{
+	// 布林欄位每8個一個byte
+	uint8 Bits = 0;
+	int32 BitCount = 0;
+	for (int32 f = 0; f < Count; ++f)
+	{
+		if (BoolFields & (1ull << f))
+		{
+			if (Values[f] != 0.f)
+			{
+				Bits |= 1 << BitCount;
+			}
+			if (++BitCount == 8)
+			{
+				Bytes.Add(Bits);
+				Bits = 0;
+				BitCount = 0;
+			}
+		}
+	}
+	if (BitCount > 0)
+	{
+		Bytes.Add(Bits);
+	}
+	// 其他欄位照順序放float 支援的平台都是little-endian 跟網頁端DataView一致
+	for (int32 f = 0; f < Count; ++f)
+	{
+		if (!(BoolFields & (1ull << f)))
+		{
+			Bytes.Append(reinterpret_cast<const uint8*>(&Values[f]), sizeof(float));
+		}
+	}
+}
+
+void FUnitHUDSnapshot::AppendBase64(FString& Out) const
+{
+	static const TCHAR Table[] = TEXT("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+	const uint8* Data = Bytes.GetData();
+	const int32 Size = Bytes.Num();
+	int32 i = 0;
+	for (; i + 2 < Size; i += 3)
+	{
+		const uint32 v = (Data[i] << 16) | (Data[i + 1] << 8) | Data[i + 2];
+		Out.AppendChar(Table[(v >> 18) & 63]);
+		Out.AppendChar(Table[(v >> 12) & 63]);
+		Out.AppendChar(Table[(v >> 6) & 63]);
+		Out.AppendChar(Table[v & 63]);
+	}
+	if (i < Size)
+	{
+		uint32 v = Data[i] << 16;
+		if (i + 1 < Size)
+		{
+			v |= Data[i + 1] << 8;
+		}
+		Out.AppendChar(Table[(v >> 18) & 63]);
+		Out.AppendChar(Table[(v >> 12) & 63]);
+		Out.AppendChar(i + 1 < Size ? Table[(v >> 6) & 63] : TEXT('='));
+		Out.AppendChar(TEXT('='));
+	}
+}
+
+void FUnitHUDText::Reset()
+{
+	UnitName.Reset();
+	SkillValues.Reset();
+	BuffValues.Reset();
+}
+
+void FUnitHUDText::Capture(ABasicUnit* Unit)
+{
+	Reset();
+	if (!IsValid(Unit))
+	{
+		return;
+	}
+	UnitName = Unit->UnitName;
+	SkillValues.SetNum(Unit->Skills.Num() * SkillTextCount);
+	BuffValues.SetNum(Unit->Buffs.Num() * BuffTextCount);
+	for (int32 i = 0; i < Unit->Skills.Num(); ++i)
+	{
+		AHeroSkill* Skill = Unit->Skills[i];
+		if (IsValid(Skill))
+		{
+			FString* Slot = &SkillValues[i * SkillTextCount];
+			Slot[0] = Skill->Name;
+			Slot[1] = Skill->Webpath;
+			Slot[2] = Skill->GetDescription();
+		}
+	}
+	for (int32 i = 0; i < Unit->Buffs.Num(); ++i)
+	{
+		AHeroBuff* Buff = Unit->Buffs[i];
+		if (IsValid(Buff))
+		{
+			FString* Slot = &BuffValues[i * BuffTextCount];
+			Slot[0] = Buff->Name;
+			Slot[1] = Buff->Webpath;
+			Slot[2] = Buff->BuffTips;
+		}
+	}
+}
+
+bool FUnitHUDText::AppendPatch(FString& Out, const FUnitHUDText& Last) const
+{
+	bool Changed = false;
+	Out.AppendChar(TEXT('{'));
+	// 大小寫不同也要重送
+	if (!UnitName.Equals(Last.UnitName, ESearchCase::CaseSensitive))
+	{
+		AppendJsonField(Out, TEXT("UnitName"), UnitName);
+		Changed = true;
+	}
+	Changed |= AppendArrayPatch(Out, SkillValues, Last.SkillValues, &SkillKey);
+	Changed |= AppendArrayPatch(Out, BuffValues, Last.BuffValues, &BuffKey);
+	Out.AppendChar(TEXT('}'));
+	return Changed;
+}
+
+const FString& FUnitHUDText::SkillKey(int32 Index)
+{
+	static const TCHAR* Names[SkillTextCount] = { TEXT("Name"), TEXT("Webpath"), TEXT("Description") };
+	static TArray<FString> Keys;
+	return CachedKey(Keys, Index, TEXT("Skill"), Names, SkillTextCount);
+}
+
+const FString& FUnitHUDText::BuffKey(int32 Index)
+{
+	static const TCHAR* Names[BuffTextCount] = { TEXT("Name"), TEXT("Webpath"), TEXT("BuffTips") };
+	static TArray<FString> Keys;
+	return CachedKey(Keys, Index, TEXT("Buff"), Names, BuffTextCount);
+}
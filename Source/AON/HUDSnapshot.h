@@ -0,0 +1,183 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABasicUnit;
+
+// 選取單位送給網頁UI的數值欄位 編號固定 網頁端ue4.js照同樣順序解
+// 新增欄位只能加在EndField前面 並同步修改ue4.js
+enum class EHUDUnitField : uint8
+{
+	TeamId,
+	IsAlive,
+	CurrentMoveSpeed,
+	CurrentMaxHP,
+	CurrentHP,
+	CurrentShield,
+	CurrentShieldPhysical,
+	CurrentShieldMagical,
+	CurrentMaxMP,
+	CurrentMP,
+	CurrentRegenHP,
+	CurrentRegenMP,
+	CurrentAttackSpeed,
+	CurrentAttackSpeedSecond,
+	CurrentAttack,
+	CurrentArmor,
+	CurrentAttackRange,
+	CurrentMagicInjured,
+	CurrentSkillIndex,
+	CurrentSkillPoints,
+	StunningLeftCounting,
+	BountyGold,
+	BaseAttack,
+	BaseArmor,
+	BaseMoveSpeed,
+	BaseAttackRange,
+	Skill_Amount,
+	Buff_Amount,
+	// 以下只有英雄有
+	AdditionStrength,
+	AdditionAgility,
+	AdditionIntelligence,
+	DeadTime,
+	BountyEXP,
+	Strength,
+	Agility,
+	Intelligence,
+	CurrentLevel,
+	CurrentEXP,
+	EndField
+};
+
+// 每個技能欄位
+enum class EHUDSkillField : uint8
+{
+	Enabled,
+	Toggle,
+	Display,
+	CDPercent,
+	CurrentCD,
+	MaxCD,
+	CanLevelUp,
+	CurrentLevel,
+	MaxLevel,
+	EndField
+};
+
+// 每個Buff欄位
+enum class EHUDBuffField : uint8
+{
+	Friendly,
+	Stacks,
+	Duration,
+	MaxDuration,
+	CanStacks,
+	EndField
+};
+
+// 選取單位的HUD狀態 每個Frame寫進同一塊記憶體 跟上次比對有變才送出
+// Bytes的格式 網頁端ue4.js照同樣順序解:
+// uint16技能數 uint16 Buff數 然後單位 每個技能 每個Buff各一段
+// 每段先放布林欄位的bit 每8個一個byte 再依欄位順序放其他欄位的float
+struct AON_API FUnitHUDSnapshot
+{
+	static const int32 UnitFieldCount = (int32)EHUDUnitField::EndField;
+	static const int32 SkillFieldCount = (int32)EHUDSkillField::EndField;
+	static const int32 BuffFieldCount = (int32)EHUDBuffField::EndField;
+
+	static_assert(UnitFieldCount <= 64 && SkillFieldCount <= 64 && BuffFieldCount <= 64, "HUD bool masks are uint64");
+
+	// 布林欄位 用bit送
+	static const uint64 UnitBoolFields = 1ull << (int32)EHUDUnitField::IsAlive;
+	static const uint64 SkillBoolFields = (1ull << (int32)EHUDSkillField::Enabled)
+		| (1ull << (int32)EHUDSkillField::Toggle)
+		| (1ull << (int32)EHUDSkillField::Display)
+		| (1ull << (int32)EHUDSkillField::CanLevelUp);
+	static const uint64 BuffBoolFields = (1ull << (int32)EHUDBuffField::Friendly)
+		| (1ull << (int32)EHUDBuffField::CanStacks);
+
+	float UnitValues[UnitFieldCount];
+	// 技能數 * SkillFieldCount
+	TArray<float> SkillValues;
+	// Buff數 * BuffFieldCount
+	TArray<float> BuffValues;
+	// 要送出的資料 Capture最後產生
+	TArray<uint8> Bytes;
+	// 名稱 圖片 描述這些文字欄位的簽章 有變才重送文字
+	uint32 TextSignature;
+
+	FUnitHUDSnapshot()
+	{
+		Reset();
+	}
+
+	FORCEINLINE void Reset()
+	{
+		FMemory::Memzero(UnitValues, sizeof(UnitValues));
+		SkillValues.Reset();
+		BuffValues.Reset();
+		Bytes.Reset();
+		TextSignature = 0;
+	}
+
+	FORCEINLINE void Set(EHUDUnitField f, float v)
+	{
+		UnitValues[(int32)f] = v;
+	}
+
+	FORCEINLINE void SetSkill(int32 Slot, EHUDSkillField f, float v)
+	{
+		SkillValues[Slot * SkillFieldCount + (int32)f] = v;
+	}
+
+	FORCEINLINE void SetBuff(int32 Slot, EHUDBuffField f, float v)
+	{
+		BuffValues[Slot * BuffFieldCount + (int32)f] = v;
+	}
+
+	FORCEINLINE bool SameValues(const FUnitHUDSnapshot& Other) const
+	{
+		return Bytes.Num() == Other.Bytes.Num()
+			&& FMemory::Memcmp(Bytes.GetData(), Other.Bytes.GetData(), Bytes.Num()) == 0;
+	}
+
+	// 讀取單位目前的狀態 技能跟Buff全部都送 沒有上限
+	void Capture(ABasicUnit* Unit);
+
+	// 把Bytes用base64接在Out後面 Out有預留空間就不會配置記憶體
+	void AppendBase64(FString& Out) const;
+
+private:
+	// 一段欄位寫進Bytes
+	void Encode(const float* Values, int32 Count, uint64 BoolFields);
+};
+
+// 選取單位的文字欄位 名稱 圖片 描述
+// 記住上次送出的值 只把有變的key送給網頁
+struct AON_API FUnitHUDText
+{
+	static const int32 SkillTextCount = 3;
+	static const int32 BuffTextCount = 3;
+
+	FString UnitName;
+	// 技能數 * SkillTextCount
+	TArray<FString> SkillValues;
+	// Buff數 * BuffTextCount
+	TArray<FString> BuffValues;
+
+	void Reset();
+
+	// 讀取單位目前的文字 沒有的欄位是空字串
+	void Capture(ABasicUnit* Unit);
+
+	// 跟Last不同的欄位寫成json物件接在Out後面 沒有不同回傳false
+	// 比上次少的技能或Buff送空字串
+	bool AppendPatch(FString& Out, const FUnitHUDText& Last) const;
+
+	// 欄位在網頁端的key 例如Skill1_Name
+	static const FString& SkillKey(int32 Index);
+	static const FString& BuffKey(int32 Index);
+};
@@ -1,5 +1,148 @@
 ﻿// Fill out your copyright notice in the Description page of Project Settings.
 
 #include "HeroAction.h"
+#include "Engine/NetSerialization.h"
+#include "BasicUnit.h"
+#include "Equipment.h"
 
+bool FHeroAction::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	enum : uint8
+	{
+		HasActor = 1,
+		HasEquipment = 2,
+		HasVec1 = 4,
+		HasVec2 = 8,
+		HasIndex = 16,
+		HasTime = 32,
+	};
+	uint8 Status = (uint8)ActionStatus;
+	uint8 Flags = 0;
+	if (Ar.IsSaving())
+	{
+		Flags |= TargetActor ? HasActor : 0;
+		Flags |= TargetEquipment ? HasEquipment : 0;
+		Flags |= !TargetVec1.IsZero() ? HasVec1 : 0;
+		Flags |= !TargetVec2.IsZero() ? HasVec2 : 0;
+		Flags |= TargetIndex1 != 0 ? HasIndex : 0;
+		Flags |= TimePoint != 0 ? HasTime : 0;
+	}
+	Ar << Status;
+	Ar << Flags;
+	ActionStatus = (EHeroActionStatus)Status;
+	bOutSuccess = true;
 
+	UObject* Actor = TargetActor;
+	if (Flags & HasActor)
+	{
+		bOutSuccess &= Map->SerializeObject(Ar, ABasicUnit::StaticClass(), Actor);
+	}
+	UObject* Equipment = TargetEquipment;
+	if (Flags & HasEquipment)
+	{
+		bOutSuccess &= Map->SerializeObject(Ar, AEquipment::StaticClass(), Equipment);
+	}
+	if (Ar.IsLoading())
+	{
+		TargetActor = (Flags & HasActor) ? Cast<ABasicUnit>(Actor) : nullptr;
+		TargetEquipment = (Flags & HasEquipment) ? Cast<AEquipment>(Equipment) : nullptr;
+		TargetVec1 = FVector::ZeroVector;
+		TargetVec2 = FVector::ZeroVector;
+		TargetIndex1 = 0;
+		TimePoint = 0;
+	}
+	// 跟FVector_NetQuantize10一樣的精度 TargetVec2是滑鼠點到的位置 不是方向
+	if (Flags & HasVec1)
+	{
+		bOutSuccess &= SerializePackedVector<10, 24>(TargetVec1, Ar);
+	}
+	if (Flags & HasVec2)
+	{
+		bOutSuccess &= SerializePackedVector<10, 24>(TargetVec2, Ar);
+	}
+	if (Flags & HasIndex)
+	{
+		uint32 Index = (uint32)TargetIndex1;
+		Ar.SerializeIntPacked(Index);
+		TargetIndex1 = (int32)Index;
+	}
+	uint32 Sequence = (uint32)SequenceNumber;
+	Ar.SerializeIntPacked(Sequence);
+	SequenceNumber = (int32)Sequence;
+	if (Flags & HasTime)
+	{
+		Ar << TimePoint;
+	}
+	return true;
+}
+
+bool FHeroActionQueue::Add(const FHeroAction& action)
+{
+	if (Count >= MaxActions)
+	{
+		return false;
+	}
+	if (Count == Slots.Num())
+	{
+		// 長大時順便排回從0開始
+		const int32 Capacity = FMath::Max(4, Slots.Num() * 2);
+		TArray<FHeroAction> Grown;
+		Grown.SetNum(Capacity);
+		for (int32 i = 0; i < Count; ++i)
+		{
+			Grown[i] = (*this)[i];
+		}
+		if (LastMove != INDEX_NONE)
+		{
+			LastMove = (LastMove - Head) & (Slots.Num() - 1);
+		}
+		Slots = MoveTemp(Grown);
+		Head = 0;
+	}
+	const int32 Slot = (Head + Count) & (Slots.Num() - 1);
+	Slots[Slot] = action;
+	Count++;
+	if (action.ActionStatus == EHeroActionStatus::MoveToPosition)
+	{
+		LastMove = Slot;
+	}
+	return true;
+}
+
+void FHeroActionQueue::Pop()
+{
+	if (Count == 0)
+	{
+		return;
+	}
+	// 放掉目標的參考
+	Slots[Head] = FHeroAction();
+	if (LastMove == Head)
+	{
+		LastMove = INDEX_NONE;
+	}
+	Head = (Head + 1) & (Slots.Num() - 1);
+	Count--;
+}
+
+void FHeroActionQueue::Empty()
+{
+	for (int32 i = 0; i < Count; ++i)
+	{
+		Slots[(Head + i) & (Slots.Num() - 1)] = FHeroAction();
+	}
+	Head = 0;
+	Count = 0;
+	LastMove = INDEX_NONE;
+}
+
+TArray<FHeroAction> FHeroActionQueue::ToArray() const
+{
+	TArray<FHeroAction> res;
+	res.Reserve(Count);
+	for (int32 i = 0; i < Count; ++i)
+	{
+		res.Add((*this)[i]);
+	}
+	return res;
+}
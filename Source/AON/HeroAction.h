@@ -18,12 +18,11 @@ struct FHeroAction
 {
 	GENERATED_USTRUCT_BODY()
 
-	FHeroAction() :ActionStatus(EHeroActionStatus::Default), TargetActor(NULL), TargetEquipment(NULL),
+	FHeroAction() :TargetActor(NULL), TargetEquipment(NULL),
 		TargetVec1(FVector::ZeroVector), TargetVec2(FVector::ZeroVector), TargetIndex1(0), 
-		SequenceNumber(0){}
+		SequenceNumber(0), TimePoint(0), ActionStatus(EHeroActionStatus::Default){}
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	EHeroActionStatus ActionStatus;
+	// 欄位由大排到小 少掉對齊的空洞
 
 	// for MoveToActor, FollowActor, AttackActor, MovingAttackActor, SpellToActor, ThrowEquToActor
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
@@ -51,18 +50,92 @@ struct FHeroAction
 	// for time start point
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float	TimePoint;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EHeroActionStatus ActionStatus;
+
+	// 網路傳輸 只送有值的欄位 TargetVec1 TargetVec2都是世界座標 量化到0.1
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
 	
-	bool operator==(const FHeroAction& rhs)
+	bool operator==(const FHeroAction& rhs) const
 	{
 		return rhs.ActionStatus == ActionStatus &&
 			rhs.SequenceNumber == SequenceNumber;
 	}
-	bool operator!=(const FHeroAction& rhs)
+	bool operator!=(const FHeroAction& rhs) const
 	{
 		return !(*this == rhs);
 	}
 };
 
+template<>
+struct TStructOpsTypeTraits<FHeroAction> : public TStructOpsTypeTraitsBase2<FHeroAction>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+// 動作駐列 固定上限的環狀緩衝
+// 推出只移動Head 不用搬後面的動作 網路上也只送Head跟Count
+USTRUCT(BlueprintType)
+struct AON_API FHeroActionQueue
+{
+	GENERATED_USTRUCT_BODY()
+
+	// 插旗最多幾個動作 滿了就不收
+	static const int32 MaxActions = 64;
+
+	int32 Num() const
+	{
+		return Count;
+	}
+
+	// 第i個動作 0是目前要做的
+	const FHeroAction& operator[](int32 i) const
+	{
+		check(i >= 0 && i < Count);
+		return Slots[(Head + i) & (Slots.Num() - 1)];
+	}
+
+	const FHeroAction& First() const
+	{
+		return (*this)[0];
+	}
+
+	// 滿了回傳false
+	bool Add(const FHeroAction& action);
+
+	// 推出第一個動作
+	void Pop();
+
+	void Empty();
+
+	// 最後一個MoveToPosition 沒有的話回傳nullptr
+	const FHeroAction* FindLastMove() const
+	{
+		return LastMove != INDEX_NONE ? &Slots[LastMove] : nullptr;
+	}
+
+	TArray<FHeroAction> ToArray() const;
+
+private:
+	// 容量是2的次方 需要時才長大
+	UPROPERTY()
+	TArray<FHeroAction> Slots;
+
+	UPROPERTY()
+	int32 Head = 0;
+
+	UPROPERTY()
+	int32 Count = 0;
+
+	// 最後一個MoveToPosition在Slots的位置 技能提示每個Frame都要
+	UPROPERTY()
+	int32 LastMove = INDEX_NONE;
+};
+
 UCLASS()
 class AON_API UHeroActionx : public UObject
 {
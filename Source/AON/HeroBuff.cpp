@@ -7,6 +7,8 @@
 #include "MOBAPlayerController.h"
 #include "Particles/ParticleSystemComponent.h"
 #include "Kismet/GameplayStatics.h"
+#include "SingletonManagerActor.h"
+#include "FlannActor.h"
 
 AHeroBuff::AHeroBuff(const FObjectInitializer& ObjectInitializer)
 	: Super(FObjectInitializer::Get())
@@ -44,7 +46,7 @@ AHeroBuff* AHeroBuff::Clone()
 	data->BuffState = BuffState;
 	data->CanStacks = CanStacks;
 	data->Stacks = Stacks;
-	data->Duration = Duration;
+	data->Duration = GetDuration();
 	return data;
 }
 
@@ -52,6 +54,59 @@ void AHeroBuff::BeginPlay()
 {
 	Super::BeginPlay();
 	MaxDuration = Duration;
+	RefreshBuffAggregate();
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->RegisterBuff(this);
+	}
+	TryRegisterAura();
+}
+
+void AHeroBuff::RefreshBuffAggregate()
+{
+	Aggregate.FromMaps(BuffPropertyMap, BuffState);
+	MarkTargetsDirty();
+}
+
+void AHeroBuff::SetBuffProperty(EHeroBuffProperty Property, float Value)
+{
+	BuffPropertyMap.FindOrAdd(Property) = Value;
+	if (Property < EHeroBuffProperty::EndBuffProperty)
+	{
+		Aggregate.Set(Property, Value);
+	}
+	MarkTargetsDirty();
+}
+
+void AHeroBuff::SetBuffPropertyMap(const TMap<EHeroBuffProperty, float>& Value)
+{
+	BuffPropertyMap = Value;
+	RefreshBuffAggregate();
+}
+
+void AHeroBuff::SetBuffState(const TArray<EHeroBuffState>& Value)
+{
+	BuffState = Value;
+	RefreshBuffAggregate();
+}
+
+void AHeroBuff::SetBuffUniqueMap(const TMap<EHeroBuffUnique, float>& Value)
+{
+	BuffUniqueMap = Value;
+	// 爆擊格檔表從這裡讀 也可能變成光環
+	MarkTargetsDirty();
+	TryRegisterAura();
+}
+
+void AHeroBuff::MarkTargetsDirty()
+{
+	for (ABasicUnit* hero : BuffTarget)
+	{
+		if (IsValid(hero))
+		{
+			hero->MarkBuffDirty();
+		}
+	}
 }
 
 void AHeroBuff::Tick(float DeltaTime)
@@ -61,144 +116,471 @@ void AHeroBuff::Tick(float DeltaTime)
 	{
 		return;
 	}
+	// 有管理者時計時由時間輪叫醒 只有藍圖實作Event Tick的才會Tick到這裡
+	if (!SimulationManaged)
+	{
+		PendingTimerEvents |= AdvanceTimers(DeltaTime);
+	}
+	TryRegisterAura();
+	ApplyTimerEvents();
+}
+
+// 時間輪叫醒時浮點誤差的容許值 避免差一點點又多排一次
+static const float TimerTolerance = 0.001f;
+
+uint8 AHeroBuff::AdvanceTimers(float DeltaTime)
+{
+	if (Role != ROLE_Authority)
+	{
+		return 0;
+	}
+	ElapseTimers(DeltaTime);
+	return CollectTimerEvents();
+}
+
+void AHeroBuff::ElapseTimers(float DeltaTime)
+{
 	if (Interval > 0 && Duration >= 0)
 	{
 		IntervalCounting += DeltaTime;
+	}
+	// 時間判斷
+	if (Forever)
+	{
+		return;
+	}
+	Duration -= DeltaTime;
+	ParticleDuration -= DeltaTime;
+	RealDuration -= DeltaTime;
+}
+
+uint8 AHeroBuff::CollectTimerEvents()
+{
+	uint8 Events = 0;
+	if (Interval > 0 && IntervalCounting + TimerTolerance >= Interval)
+	{
+		IntervalCount++;
+		// 晚到的部分留給下一次 卡頓很久也只觸發一次
+		IntervalCounting = FMath::Max(IntervalCounting - Interval, 0.f);
 		if (IntervalCounting >= Interval)
 		{
-			IntervalCount++;
 			IntervalCounting = 0;
-			OnInterval(IntervalCount);
+		}
+		Events |= TimerEvent_Interval;
+	}
+	if (Forever)
+	{
+		return Events;
+	}
+	if (!ParticleEnded && ParticleDuration <= TimerTolerance)
+	{
+		ParticleEnded = true;
+		Events |= TimerEvent_ParticleEnd;
+	}
+	if (!DurationEnded && Duration <= TimerTolerance)
+	{
+		DurationEnded = true;
+		Events |= TimerEvent_DurationEnd;
+	}
+	if (RealDuration <= TimerTolerance)
+	{
+		Events |= TimerEvent_Expired;
+	}
+	return Events;
+}
+
+float AHeroBuff::NextTimerDelay() const
+{
+	float Next = MAX_flt;
+	// 跟ElapseTimers一樣 Duration小於0後就不再數間隔
+	if (Interval > 0 && Duration >= 0)
+	{
+		const float Left = FMath::Max(Interval - IntervalCounting, 0.f);
+		if (Forever || Left <= Duration)
+		{
+			Next = Left;
+		}
+	}
+	if (!Forever)
+	{
+		if (!ParticleEnded)
+		{
+			Next = FMath::Min(Next, FMath::Max(ParticleDuration, 0.f));
+		}
+		if (!DurationEnded)
+		{
+			Next = FMath::Min(Next, FMath::Max(Duration, 0.f));
+		}
+		Next = FMath::Min(Next, FMath::Max(RealDuration, 0.f));
+	}
+	return Next;
+}
+
+float AHeroBuff::TimerElapsed() const
+{
+	if (!SimulationManaged || Role != ROLE_Authority || !GetWorld())
+	{
+		return 0;
+	}
+	return (GetWorld()->GetTimeSeconds() - TimerBaseTime) * TimerDilation;
+}
+
+void AHeroBuff::SyncTimers()
+{
+	const float Elapsed = TimerElapsed();
+	if (Elapsed > 0)
+	{
+		ElapseTimers(Elapsed);
+	}
+	if (GetWorld())
+	{
+		TimerBaseTime = GetWorld()->GetTimeSeconds();
+	}
+	TimerDilation = CustomTimeDilation;
+}
+
+void AHeroBuff::RescheduleTimers()
+{
+	ASingletonManagerActor* sm = ASingletonManagerActor::Get(this);
+	if (sm)
+	{
+		sm->CancelTimer(TimerHandle);
+	}
+	TimerHandle.Invalidate();
+	if (!sm || !SimulationManaged || Role != ROLE_Authority || IsPendingKillPending())
+	{
+		return;
+	}
+	SyncTimers();
+	const float Next = NextTimerDelay();
+	if (Next < MAX_flt && CustomTimeDilation > 0)
+	{
+		TimerHandle = sm->ScheduleTimer(this, Next / CustomTimeDilation);
+	}
+	else if (Next < MAX_flt)
+	{
+		// 時間暫停的Buff 定期醒來看藍圖有沒有直接把Dilation改回來
+		TimerHandle = sm->ScheduleTimer(this, 0.25f);
+	}
+}
+
+void AHeroBuff::SetCustomTimeDilation(float v)
+{
+	SyncTimers();
+	CustomTimeDilation = v;
+	RescheduleTimers();
+}
+
+void AHeroBuff::OnTimerDue(const FTimerWheelHandle& Handle)
+{
+	if (Handle != TimerHandle)
+	{
+		return;
+	}
+	TimerHandle.Invalidate();
+	SyncTimers();
+	PendingTimerEvents |= CollectTimerEvents();
+	ApplyTimerEvents();
+	if (IsPendingKillPending())
+	{
+		return;
+	}
+	TryRegisterAura();
+	// 藍圖事件裡改了時間的話已經重排過 這裡再排一次結果一樣
+	RescheduleTimers();
+}
+
+void AHeroBuff::SetSimulationManaged(bool Managed)
+{
+	if (SimulationManaged == Managed)
+	{
+		return;
+	}
+	SyncTimers();
+	SimulationManaged = Managed;
+	RescheduleTimers();
+}
+
+bool AHeroBuff::HasBlueprintTick() const
+{
+	return GetClass()->IsFunctionImplementedInBlueprint(GET_FUNCTION_NAME_CHECKED(AHeroBuff, ReceiveTick));
+}
+
+float AHeroBuff::GetDuration() const
+{
+	return Forever ? Duration : Duration - TimerElapsed();
+}
+
+bool AHeroBuff::IsDurationOver() const
+{
+	// 永久的buff不會數Duration
+	if (Forever)
+	{
+		return Duration < 0;
+	}
+	return DurationEnded || GetDuration() <= TimerTolerance;
+}
+
+float AHeroBuff::GetParticleDuration() const
+{
+	return Forever ? ParticleDuration : ParticleDuration - TimerElapsed();
+}
+
+float AHeroBuff::GetRealDuration() const
+{
+	return Forever ? RealDuration : RealDuration - TimerElapsed();
+}
+
+void AHeroBuff::SetDuration(float Value)
+{
+	SyncTimers();
+	Duration = Value;
+	DurationEnded = false;
+	RescheduleTimers();
+}
+
+void AHeroBuff::SetParticleDuration(float Value)
+{
+	SyncTimers();
+	ParticleDuration = Value;
+	ParticleEnded = false;
+	RescheduleTimers();
+}
+
+void AHeroBuff::SetRealDuration(float Value)
+{
+	SyncTimers();
+	RealDuration = Value;
+	RescheduleTimers();
+}
+
+void AHeroBuff::SetInterval(float Value)
+{
+	SyncTimers();
+	Interval = Value;
+	RescheduleTimers();
+}
+
+void AHeroBuff::SetForever(bool Value)
+{
+	SyncTimers();
+	Forever = Value;
+	RescheduleTimers();
+}
+
+void AHeroBuff::TryRegisterAura()
+{
+	// 光環 目標由AFlannActor批次更新
+	if (AuraRegistered || Role != ROLE_Authority || IsDurationOver() || !IsValid(BuffTargetOne)
+		|| !(BuffUniqueMap.Contains(HEROU::AuraRadiusEnemy) || BuffUniqueMap.Contains(HEROU::AuraRadiusFriends)))
+	{
+		return;
+	}
+	if (AFlannActor* fa = AFlannActor::Get(this))
+	{
+		fa->RegisterAura(this);
+		AuraRegistered = true;
+	}
+}
+
+void AHeroBuff::ApplyTimerEvents()
+{
+	const uint8 Events = PendingTimerEvents;
+	PendingTimerEvents = 0;
+	if (Events & TimerEvent_Interval)
+	{
+		OnInterval(IntervalCount);
+	}
+	if ((Events & TimerEvent_ParticleEnd) && IsValid(Particle))
+	{
+		Particle->Deactivate();
+	}
+	if (Events & TimerEvent_DurationEnd)
+	{
+		ExpireFromTargets();
+	}
+	if ((Events & TimerEvent_Expired) && !IsPendingKillPending())
+	{
+		this->Destroy();
+	}
+}
+
+void AHeroBuff::ExpireFromTargets()
+{
+	// 呼叫消失事件時藍圖可能改到BuffTarget
+	TArray<ABasicUnit*> Targets = BuffTarget.Array();
+	for (ABasicUnit* hero : Targets)
+	{
+		if (IsValid(hero))
+		{
+			hero->ExpireBuff(this);
+		}
+	}
+}
+
+
+void AHeroBuff::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	AFlannActor* fa = AuraRegistered ? AFlannActor::Get(this) : nullptr;
+	if (fa)
+	{
+		fa->UnregisterAura(this);
+	}
+	AuraRegistered = false;
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->UnregisterBuff(this);
+	}
+	// 單位在下個Tick把這個Buff移掉
+	for (ABasicUnit* hero : BuffTarget)
+	{
+		if (IsValid(hero))
+		{
+			hero->BuffsPendingPurge = true;
 		}
 	}
-	// 光環
-	if (Duration >= 0 && IsValid(BuffTargetOne))
+	Super::EndPlay(EndPlayReason);
+}
+
+void AHeroBuff::AppendAuraQueries(TArray<FRadiusQuery>& Queries)
+{
+	if (IsDurationOver() || !IsValid(BuffTargetOne))
+	{
+		return;
+	}
+	if (BuffUniqueMap.Contains(HEROU::AuraRadiusEnemy))
+	{
+		FRadiusQuery& query = Queries.AddDefaulted_GetRef();
+		query.Hero = BuffTargetOne;
+		query.Center = BuffTargetOne->GetActorLocation();
+		query.Radius = BuffUniqueMap[HEROU::AuraRadiusEnemy];
+		query.Flag = ETeamFlag::TeamEnemy;
+		query.CheckAlive = true;
+	}
+	if (BuffUniqueMap.Contains(HEROU::AuraRadiusFriends))
+	{
+		FRadiusQuery& query = Queries.AddDefaulted_GetRef();
+		query.Hero = BuffTargetOne;
+		query.Center = BuffTargetOne->GetActorLocation();
+		query.Radius = BuffUniqueMap[HEROU::AuraRadiusFriends];
+		query.Flag = ETeamFlag::TeamFriends;
+		query.CheckAlive = true;
+	}
+}
+
+bool AHeroBuff::GetAuraShape(FVector& Center, float& RadiusEnemy, float& RadiusFriends) const
+{
+	if (IsDurationOver() || !IsValid(BuffTargetOne))
+	{
+		return false;
+	}
+	const float* Enemy = BuffUniqueMap.Find(HEROU::AuraRadiusEnemy);
+	const float* Friends = BuffUniqueMap.Find(HEROU::AuraRadiusFriends);
+	if (!Enemy && !Friends)
+	{
+		return false;
+	}
+	Center = BuffTargetOne->GetActorLocation();
+	RadiusEnemy = Enemy ? *Enemy : -1;
+	RadiusFriends = Friends ? *Friends : -1;
+	return true;
+}
+
+void AHeroBuff::OnAuraEnter(ABasicUnit* hero)
+{
+	BuffTarget.Add(hero);
+	hero->AddUniqueBuff(this, BuffTargetOne);
+	if (IsValid(AuraParticle))
 	{
-		AuraCount += DeltaTime;
-		if (AuraCount > 0.1)
+		if (AuraFollowActor)
 		{
-			AuraCount = 0;
-			TSet<ABasicUnit*> tmp;
-			bool hasaura = false;
-			if (BuffUniqueMap.Contains(HEROU::AuraRadiusEnemy))
+			UParticleSystemComponent* emitter = NULL;
+			switch (AuraFollowPosition)
+			{
+			case EBuffPosition::Head:
+			{
+				emitter = UGameplayStatics::SpawnEmitterAttached(
+					AuraParticle, hero->PositionOnHead);
+			}	
+				break;
+			case EBuffPosition::Foot:
+			{
+				emitter = UGameplayStatics::SpawnEmitterAttached(
+					AuraParticle, hero->PositionUnderFoot);
+			}
+				break;
+			case EBuffPosition::Root:
 			{
-				hasaura = true;
-				float range = BuffUniqueMap[HEROU::AuraRadiusEnemy];
-				TArray<ABasicUnit*> Enemys = ABasicUnit::localPC->FindRadiusActorByLocation(
-					BuffTargetOne, BuffTargetOne->GetActorLocation(), range, ETeamFlag::TeamEnemy, true);
-				range *= range;
-				for (ABasicUnit* EachHero : Enemys)
-				{
-					tmp.Add(EachHero);
-				}
+				emitter = UGameplayStatics::SpawnEmitterAttached(
+					AuraParticle, hero->GetRootComponent());
+			}
+				break;
+			default:
+				break;
 			}
-			if (BuffUniqueMap.Contains(HEROU::AuraRadiusFriends))
+			if (hero->AuraParticles.Contains(Name))
 			{
-				hasaura = true;
-				float range = BuffUniqueMap[HEROU::AuraRadiusFriends];
-				TArray<ABasicUnit*> Enemys = ABasicUnit::localPC->FindRadiusActorByLocation(
-					BuffTargetOne, BuffTargetOne->GetActorLocation(), range, ETeamFlag::TeamFriends, true);
-				range *= range;
-				for (ABasicUnit* EachHero : Enemys)
-				{
-					tmp.Add(EachHero);
-				}
+				hero->AuraParticles[Name]->DestroyComponent();
+				hero->AuraParticles.Remove(Name);
 			}
-			// 如果有光環
-			if (hasaura)
+			if (IsValid(emitter))
 			{
-				// 拿到要得到光環的Actor
-				for (ABasicUnit* hero : tmp)
-				{
-					if (!BuffTarget.Contains(hero))
-					{
-						//Result1.Add(hero);
-						hero->AddUniqueBuff(this, BuffTargetOne);
-						if (IsValid(AuraParticle))
-						{
-							if (AuraFollowActor)
-							{
-								UParticleSystemComponent* emitter = NULL;
-								switch (AuraFollowPosition)
-								{
-								case EBuffPosition::Head:
-								{
-									emitter = UGameplayStatics::SpawnEmitterAttached(
-										AuraParticle, hero->PositionOnHead);
-								}	
-									break;
-								case EBuffPosition::Foot:
-								{
-									emitter = UGameplayStatics::SpawnEmitterAttached(
-										AuraParticle, hero->PositionUnderFoot);
-								}
-									break;
-								case EBuffPosition::Root:
-								{
-									emitter = UGameplayStatics::SpawnEmitterAttached(
-										AuraParticle, hero->GetRootComponent());
-								}
-									break;
-								default:
-									break;
-								}
-								if (hero->AuraParticles.Contains(Name))
-								{
-									hero->AuraParticles[Name]->DestroyComponent();
-									hero->AuraParticles.Remove(Name);
-								}
-								if (IsValid(emitter))
-								{
-									hero->AuraParticles.Add(Name, emitter);
-								}
-							}
-							else
-							{
-								UParticleSystemComponent* emitter = UGameplayStatics::SpawnEmitterAtLocation(
-									GetWorld(), AuraParticle, hero->GetActorLocation(), FRotator::ZeroRotator, true);
-							}
-						}
-					}
-				}
-				// 拿到要被刪除光環的Actor
-				for (ABasicUnit* hero : BuffTarget)
-				{
-					if (!tmp.Contains(hero))
-					{
-						hero->RemoveBuff(this, BuffTargetOne);
-						if (hero->AuraParticles.Contains(Name))
-						{
-							hero->AuraParticles[Name]->DestroyComponent();
-							hero->AuraParticles.Remove(Name);
-						}
-					}
-				}
-				BuffTarget = tmp;
+				hero->AuraParticles.Add(Name, emitter);
 			}
 		}
+		else
+		{
+			UGameplayStatics::SpawnEmitterAtLocation(
+				GetWorld(), AuraParticle, hero->GetActorLocation(), FRotator::ZeroRotator, true);
+		}
 	}
-	// 時間判斷
-	if (!Forever)
+}
+
+void AHeroBuff::OnAuraExit(ABasicUnit* hero)
+{
+	BuffTarget.Remove(hero);
+	if (!IsValid(hero))
 	{
-		Duration -= DeltaTime;
-		ParticleDuration -= DeltaTime;
-		RealDuration -= DeltaTime;
+		return;
 	}
-	else
+	hero->RemoveBuff(this, BuffTargetOne);
+	if (hero->AuraParticles.Contains(Name))
 	{
-		return;
+		hero->AuraParticles[Name]->DestroyComponent();
+		hero->AuraParticles.Remove(Name);
 	}
-	if (ParticleDuration <= 0)
+}
+
+void AHeroBuff::UpdateAuraTargets(TArrayView<ABasicUnit*> Targets)
+{
+	AuraScratch.Reset();
+	for (ABasicUnit* EachHero : Targets)
 	{
-		Particle->Deactivate();
+		AuraScratch.Add(EachHero);
 	}
-	if (RealDuration <= 0 && !IsPendingKillPending())
+	// 拿到要被刪除光環的Actor 先複製一份 OnAuraExit會改BuffTarget
+	AuraLeaving.Reset();
+	for (ABasicUnit* hero : BuffTarget)
 	{
-		this->Destroy();
+		if (!AuraScratch.Contains(hero))
+		{
+			AuraLeaving.Add(hero);
+		}
+	}
+	for (ABasicUnit* hero : AuraLeaving)
+	{
+		OnAuraExit(hero);
+	}
+	// 拿到要得到光環的Actor
+	for (ABasicUnit* hero : AuraScratch)
+	{
+		if (!BuffTarget.Contains(hero))
+		{
+			OnAuraEnter(hero);
+		}
 	}
 }
 
-
 void AHeroBuff::AddStack(int32 amount)
 {
 	int32 laststack = Stacks;
@@ -215,6 +597,8 @@ void AHeroBuff::AddStack(int32 amount)
 	{
 		OnStackModify(laststack, Stacks);
 	}
+	// OnStackModify會改BuffPropertyMap
+	RefreshBuffAggregate();
 }
 
 void AHeroBuff::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLifetimeProps) const
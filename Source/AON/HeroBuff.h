@@ -4,6 +4,9 @@
 
 #include "Object.h"
 #include "MobaEnum.h"
+#include "Containers/ArrayView.h"
+#include "BuffAggregate.h"
+#include "TimerWheel.h"
 #include "HeroBuff.generated.h"
 
 USTRUCT(BlueprintType)
@@ -23,6 +26,7 @@ struct FLevelVariable
 
 class ABasicUnit;
 class AHeroSkill;
+struct FRadiusQuery;
 /**
  * 
  */
@@ -44,9 +48,22 @@ public:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	//光環 加入這個Buff的範圍查詢 由AFlannActor一次批次處理
+	void AppendAuraQueries(TArray<FRadiusQuery>& Queries);
+	//光環 批次查詢的結果 更新光環目標
+	void UpdateAuraTargets(TArrayView<ABasicUnit*> Targets);
+	//光環 目前的中心跟半徑 沒有作用時回傳false 沒有的半徑是-1
+	bool GetAuraShape(FVector& Center, float& RadiusEnemy, float& RadiusFriends) const;
+	//光環 單位進入範圍
+	void OnAuraEnter(ABasicUnit* hero);
+	//光環 單位離開範圍
+	void OnAuraExit(ABasicUnit* hero);
+
 	//Buff時間到時消失的瞬間
 	//但是被消除Buff時不會呼叫
 	UFUNCTION(BlueprintImplementableEvent, Category = "MOBA")
@@ -153,6 +170,49 @@ public:
 	UFUNCTION(BlueprintImplementableEvent, Category = "MOBA")
 	void OnInterval(int32 count);
 
+	//更新攤平的加成 整個設定BuffPropertyMap BuffState會自動呼叫
+	//藍圖直接改Map裡面的值(Add Remove)之後要自己呼叫
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void RefreshBuffAggregate();
+
+	//時間輪模式下Duration系列只在事件時更新 讀取時要加上經過的時間
+	UFUNCTION(BlueprintGetter)
+	float GetDuration() const;
+	UFUNCTION(BlueprintGetter)
+	float GetParticleDuration() const;
+	UFUNCTION(BlueprintGetter)
+	float GetRealDuration() const;
+
+	//修改時間都要重新排下一次事件
+	UFUNCTION(BlueprintSetter)
+	void SetDuration(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetParticleDuration(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetRealDuration(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetInterval(float Value);
+	UFUNCTION(BlueprintSetter)
+	void SetForever(bool Value);
+
+	//改時間倍率 舊的倍率算到現在再重排 藍圖要用這個不要直接改CustomTimeDilation
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void SetCustomTimeDilation(float v);
+
+	//修改單一加成
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void SetBuffProperty(EHeroBuffProperty Property, float Value);
+
+	UFUNCTION(BlueprintSetter)
+	void SetBuffPropertyMap(const TMap<EHeroBuffProperty, float>& Value);
+	UFUNCTION(BlueprintSetter)
+	void SetBuffState(const TArray<EHeroBuffState>& Value);
+	UFUNCTION(BlueprintSetter)
+	void SetBuffUniqueMap(const TMap<EHeroBuffUnique, float>& Value);
+
+	//通知所有目標重新加總buff
+	void MarkTargetsDirty();
+
 	//增加Buff層數，可以是負數
 	UFUNCTION(BlueprintCallable, Category = "MOBA")
 	void AddStack(int32 amount);
@@ -211,19 +271,22 @@ public:
 	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadOnly)
 	UTexture2D * Head;
 
-	// 額外效果 暈眩、禁言等
-	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
+	// 額外效果 暈眩、禁言等 藍圖整個設定時會更新加成
+	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintSetter = SetBuffState)
 	TArray<EHeroBuffState> BuffState;
 
-	// 額外加成
-	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
+	// 額外加成 藍圖整個設定時會更新加成
+	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintSetter = SetBuffPropertyMap)
 	TMap<EHeroBuffProperty, float> BuffPropertyMap;
 
 	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
 	TMap<FString, FLevelVariable> VariableMap;
 
-	// 不可疊加的額外加成
-	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
+	// 攤平的BuffPropertyMap跟BuffState 加總時用
+	FBuffAggregate Aggregate;
+
+	// 不可疊加的額外加成 藍圖整個設定時會通知目標
+	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintSetter = SetBuffUniqueMap)
 	TMap<EHeroBuffUnique, float> BuffUniqueMap;
 
 	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
@@ -238,7 +301,7 @@ public:
 
 	// 是否永久存在，如果為true則無視Duration存在著
 	// 值也不再更新但OnInterval一樣會發動
-	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintSetter = SetForever)
 	bool Forever = false;
 
 	// 疊加層數
@@ -253,15 +316,15 @@ public:
 	bool Friendly = true;
 
 	// 當前持續時間
-	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintGetter = GetDuration, BlueprintSetter = SetDuration)
 	float Duration;
 
 	// Particle特效的存活時間
-	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintGetter = GetParticleDuration, BlueprintSetter = SetParticleDuration)
 	float ParticleDuration;
 
 	// Actor真正的存活時間，設定的比Duration長來讓特效不要消失的太突然
-	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(Category = "MOBA", meta = (ExposeOnSpawn = "true"), EditAnywhere, BlueprintGetter = GetRealDuration, BlueprintSetter = SetRealDuration)
 	float RealDuration;
 
 	// 總共時間在beginplay時會變成當前持續時間
@@ -269,19 +332,83 @@ public:
 	float MaxDuration;
 
 	// 每幾秒自動呼叫事件
-	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintSetter = SetInterval)
 	float Interval;
 
 	// 時間事件計數
 	UPROPERTY(Category = "MOBA", EditAnywhere, BlueprintReadWrite)
 	float IntervalCount;
-	// 光環更新計數
-	float AuraCount;
+	// 是否已註冊到光環批次查詢
+	bool AuraRegistered = false;
+	// 光環目標暫存 避免每次配置
+	TSet<ABasicUnit*> AuraScratch;
+	TArray<ABasicUnit*> AuraLeaving;
 
 	//當出現混色狀態時Blending，使用這個變數對英雄染色
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Current", Replicated)
 	FLinearColor BlendingColor = FLinearColor::White;
 
 	float IntervalCounting;
+
+	//沒有管理者時每個Frame倒數時間 回傳要觸發的事件
+	uint8 AdvanceTimers(float DeltaTime);
+
+	//觸發累積的事件 要在遊戲執行緒上呼叫
+	void ApplyTimerEvents();
+
+	//時間輪叫醒 不是目前的handle就忽略
+	void OnTimerDue(const FTimerWheelHandle& Handle);
+
+	//切換成由ASingletonManagerActor的時間輪驅動
+	void SetSimulationManaged(bool Managed);
+
+	//藍圖有實作Event Tick 這種buff交給時間輪後還是要留著tick
+	bool HasBlueprintTick() const;
+
+	//Duration已經結束 跟AdvanceTimers用同一個容許值 光環用這個判斷
+	bool IsDurationOver() const;
+
+	//把上次事件後經過的時間寫回Duration系列
+	void SyncTimers();
+
+	//排下一個最早的事件 間隔 特效結束 Duration結束 真正消失
+	void RescheduleTimers();
+
+	//光環 條件成立時註冊到AFlannActor
+	void TryRegisterAura();
+
+	//Duration到了 從還掛著這個Buff的單位身上移除
+	void ExpireFromTargets();
+
+	//是否由ASingletonManagerActor的時間輪驅動
+	bool SimulationManaged = false;
+
+	//等待觸發的事件
+	uint8 PendingTimerEvents = 0;
+
+	//時間事件
+	enum ETimerEvent : uint8
+	{
+		TimerEvent_Interval = 1,
+		TimerEvent_ParticleEnd = 2,
+		TimerEvent_Expired = 4,
+		TimerEvent_DurationEnd = 8,
+	};
+
+private:
+	//時間輪模式下從TimerBaseTime到現在經過的時間
+	float TimerElapsed() const;
+	void ElapseTimers(float DeltaTime);
+	uint8 CollectTimerEvents();
+	//離下一個事件的時間 沒有事件時回傳MAX_flt
+	float NextTimerDelay() const;
+
+	FTimerWheelHandle TimerHandle;
+	//Duration系列是這個時間的值
+	float TimerBaseTime = 0;
+	//TimerBaseTime之後用的時間倍率 直接改CustomTimeDilation不會影響已經過的時間
+	float TimerDilation = 1;
+	bool ParticleEnded = false;
+	bool DurationEnded = false;
 };
 
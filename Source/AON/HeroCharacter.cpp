@@ -163,16 +163,16 @@ void AHeroCharacter::UpdateHPMPAS()
 	if (ags) 
 	{
 		CurrentMaxHP = BaseHP + Strength * ags->StrengthToHP;
-		CurrentRegenHP = (BaseRegenHP + Strength * ags->StrengthToHealingHP) * BuffPropertyMap[HEROP::HealPercentage];
+		CurrentRegenHP = (BaseRegenHP + Strength * ags->StrengthToHealingHP) * GetBuffProperty(HEROP::HealPercentage);
 		CurrentMaxMP = BaseMP + Intelligence * ags->IntelligenceToMP;
 		CurrentRegenMP = BaseRegenMP + Intelligence * ags->IntelligenceToHealingMP;
-		CurrentAttack = (((BaseAttack + BuffPropertyMap[HEROP::AttackBounsConstantWhite])*
-			(1+BuffPropertyMap[HEROP::AttackBounsPercentage]) + BuffPropertyMap[HEROP::AttackBounsConstantGreen])*
-			BuffPropertyMap[HEROP::PhysicalDamageOutputPercentage]);
+		CurrentAttack = (((BaseAttack + GetBuffProperty(HEROP::AttackBounsConstantWhite))*
+			(1+GetBuffProperty(HEROP::AttackBounsPercentage)) + GetBuffProperty(HEROP::AttackBounsConstantGreen))*
+			GetBuffProperty(HEROP::PhysicalDamageOutputPercentage));
 		
 		CurrentAttackSpeed = (100 + (Agility * ags->AgilityToAttackSpeed + 
-			100 * BuffPropertyMap[HEROP::AttackSpeedConstant])) *
-			BuffPropertyMap[HEROP::AttackSpeedRatio] * 0.01;
+			100 * GetBuffProperty(HEROP::AttackSpeedConstant))) *
+			GetBuffProperty(HEROP::AttackSpeedRatio) * 0.01;
 		CurrentAttackSpeedSecond = BaseAttackSpeedSecond / (1 + CurrentAttackSpeed);
 		CurrentArmor = BaseArmor + Agility * ags->AgilityToDefense;
 		if (CurrentAttackSpeedSecond > 0)
@@ -204,51 +204,51 @@ void AHeroCharacter::UpdateSAI()
 	{
 		if (CurrentLevel <= LevelProperty_Strength.Num())
 		{
-			Strength = BaseStrength + LevelProperty_Strength[CurrentLevel - 1] + BuffPropertyMap[HEROP::Strength];
+			Strength = BaseStrength + LevelProperty_Strength[CurrentLevel - 1] + GetBuffProperty(HEROP::Strength);
 		}
 		else if (LevelProperty_Strength.Num() > 0)
 		{
-			Strength = BaseStrength + LevelProperty_Strength.Last() + BuffPropertyMap[HEROP::Strength];
+			Strength = BaseStrength + LevelProperty_Strength.Last() + GetBuffProperty(HEROP::Strength);
 		}
 	}
 	else
 	{
-		Strength = BaseStrength + BuffPropertyMap[HEROP::Strength];
+		Strength = BaseStrength + GetBuffProperty(HEROP::Strength);
 	}
 	if (LevelProperty_Agility.Num() > 0)
 	{
 		if(CurrentLevel <= LevelProperty_Agility.Num())
 		{
-			Agility = BaseAgility + LevelProperty_Agility[CurrentLevel - 1] + BuffPropertyMap[HEROP::Agility];
+			Agility = BaseAgility + LevelProperty_Agility[CurrentLevel - 1] + GetBuffProperty(HEROP::Agility);
 		}
 		else if(LevelProperty_Agility.Num() > 0)
 		{
-			Agility = BaseAgility + LevelProperty_Agility.Last() + BuffPropertyMap[HEROP::Agility];
+			Agility = BaseAgility + LevelProperty_Agility.Last() + GetBuffProperty(HEROP::Agility);
 		}
 	}
 	else
 	{
-		Agility = BaseAgility + BuffPropertyMap[HEROP::Agility];
+		Agility = BaseAgility + GetBuffProperty(HEROP::Agility);
 	}
 
 	if (LevelProperty_Intelligence.Num() > 0)
 	{
 		if (CurrentLevel <= LevelProperty_Intelligence.Num())
 		{
-			Intelligence = BaseIntelligence + LevelProperty_Intelligence[CurrentLevel - 1] + BuffPropertyMap[HEROP::Intelligence];
+			Intelligence = BaseIntelligence + LevelProperty_Intelligence[CurrentLevel - 1] + GetBuffProperty(HEROP::Intelligence);
 		}
 		else if (LevelProperty_Intelligence.Num() > 0)
 		{
-			Intelligence = BaseIntelligence + LevelProperty_Intelligence.Last() + BuffPropertyMap[HEROP::Intelligence];
+			Intelligence = BaseIntelligence + LevelProperty_Intelligence.Last() + GetBuffProperty(HEROP::Intelligence);
 		}
 	}
 	else
 	{
-		Intelligence = BaseIntelligence + BuffPropertyMap[HEROP::Intelligence];
+		Intelligence = BaseIntelligence + GetBuffProperty(HEROP::Intelligence);
 	}
-	AdditionStrength = BuffPropertyMap[HEROP::Strength];
-	AdditionAgility = BuffPropertyMap[HEROP::Agility];
-	AdditionIntelligence = BuffPropertyMap[HEROP::Intelligence];
+	AdditionStrength = GetBuffProperty(HEROP::Strength);
+	AdditionAgility = GetBuffProperty(HEROP::Agility);
+	AdditionIntelligence = GetBuffProperty(HEROP::Intelligence);
 }
 
 
@@ -258,7 +258,7 @@ void AHeroCharacter::ForceLevelUp()
 	if (CurrentLevel + 1 <= ags->MaxLevel)
 	{
 		CurrentLevel++;
-		CurrentSkillPoints++;
+		SetCurrentSkillPoints(CurrentSkillPoints + 1);
 	}
 	CurrentEXP = 0;
 	for (int32 i = 0; i < EXPIncreaseArray.Num() && i <= CurrentLevel; ++i)
@@ -293,7 +293,7 @@ void AHeroCharacter::AddExpCompute(float exp)
 			{
 				int32 nextlv = i + 1;
 				//增加技能點 Add Skill Points
-				CurrentSkillPoints += nextlv - CurrentLevel;
+				SetCurrentSkillPoints(CurrentSkillPoints + nextlv - CurrentLevel);
 				//TODO: call level up
 				CurrentLevel = nextlv;
 			}
@@ -305,7 +305,6 @@ void AHeroCharacter::AddExpCompute(float exp)
 void AHeroCharacter::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME(AHeroCharacter, CurrentSkillPoints);
 	DOREPLIFETIME(AHeroCharacter, CurrentLevel);
 	DOREPLIFETIME(AHeroCharacter, CurrentEXP);
 }
@@ -3,6 +3,8 @@
 #include "HeroSkill.h"
 #include "UnrealNetwork.h"
 #include "HeroCharacter.h"
+#include "SingletonManagerActor.h"
+#include "MOBAGameState.h"
 
 // Sets default values
 AHeroSkill::AHeroSkill()
@@ -35,6 +37,7 @@ void AHeroSkill::BeginPlay()
 	}
 	MaxLevel = LevelCD.Num();
 	ChannellingCounting = ChannellingTime;
+	CompileDescription();
 }
 
 
@@ -42,35 +45,138 @@ bool AHeroSkill::ReadySpell()
 {
 	GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Cyan,
 		FString::Printf(TEXT("CurrentLevel %d Enable %d"), CurrentLevel, Enable));
-	if (IsEnable() && CurrentLevel > 0 && CurrentCD >= MaxCD)
+	if (IsEnable() && CurrentLevel > 0 && GetCurrentCD() >= MaxCD)
 	{
 		return true;
 	}
 	return false;
 }
 
+// CD跟著施法者的時間倍率 只在伺服器起算時讀 之後用同步的CDTimeRate
+static float GetCDRate(const AHeroSkill* Skill)
+{
+	return IsValid(Skill->Caster) ? Skill->Caster->CustomTimeDilation : 1.f;
+}
+
 void AHeroSkill::StartCD()
 {
 	CDing = true;
 	CurrentCD = 0;
+	CDStartTime = AMOBAGameState::GetServerWorldTime(this);
+	CDTimeRate = GetCDRate(this);
 	ChannellingCounting = 0;
 	if (SkillBehavior[HEROB::Channelled])
 	{
 		IsChannelling = true;
 	}
 	MaxCD = CDRatio * LevelCD[CurrentLevel - 1];
+	ScheduleCD();
 }
 
 void AHeroSkill::EndCD()
 {
 	CDing = false;
 	CurrentCD = MaxCD;
+	ScheduleCD();
+}
+
+// 時間輪叫醒時浮點誤差的容許值
+static const float CDTolerance = 0.001f;
+
+float AHeroSkill::GetCurrentCD() const
+{
+	// 用記下來的倍率 客戶端沒有施法者的CustomTimeDilation
+	if (!CDing || CDTimeRate <= 0 || !GetWorld())
+	{
+		return CurrentCD;
+	}
+	// 用戶端的伺服器時間可能稍微落後
+	const float Elapsed = FMath::Max(AMOBAGameState::GetServerWorldTime(this) - CDStartTime, 0.f) * CDTimeRate;
+	return FMath::Min(CurrentCD + Elapsed, MaxCD);
+}
+
+void AHeroSkill::SetCurrentCD(float Value)
+{
+	CurrentCD = Value;
+	CDStartTime = AMOBAGameState::GetServerWorldTime(this);
+	CDTimeRate = GetCDRate(this);
+	ScheduleCD();
+}
+
+void AHeroSkill::SetCDing(bool Value)
+{
+	SyncCD();
+	if (Value && !CDing)
+	{
+		// 從現在開始倒數 不然會算上次CD到現在的時間
+		CDStartTime = AMOBAGameState::GetServerWorldTime(this);
+		CDTimeRate = GetCDRate(this);
+	}
+	CDing = Value;
+	ScheduleCD();
+}
+
+void AHeroSkill::SetMaxCD(float Value)
+{
+	SyncCD();
+	MaxCD = Value;
+	ScheduleCD();
+}
+
+void AHeroSkill::SyncCD()
+{
+	if (CDing && GetWorld())
+	{
+		CurrentCD = GetCurrentCD();
+		CDStartTime = AMOBAGameState::GetServerWorldTime(this);
+		CDTimeRate = GetCDRate(this);
+	}
+}
+
+void AHeroSkill::ScheduleCD()
+{
+	ASingletonManagerActor* sm = ASingletonManagerActor::Get(this);
+	if (sm)
+	{
+		sm->CancelTimer(CDTimer);
+	}
+	CDTimer.Invalidate();
+	if (!CDing || !sm || Role != ROLE_Authority || CDTimeRate <= 0)
+	{
+		return;
+	}
+	CDTimer = sm->ScheduleTimer(this, FMath::Max(MaxCD - GetCurrentCD(), 0.f) / CDTimeRate);
+}
+
+void AHeroSkill::OnTimerDue(const FTimerWheelHandle& Handle)
+{
+	if (Handle != CDTimer)
+	{
+		return;
+	}
+	CDTimer.Invalidate();
+	if (!CDing)
+	{
+		return;
+	}
+	if (GetCurrentCD() + CDTolerance >= MaxCD)
+	{
+		CurrentCD = MaxCD;
+		CDing = false;
+		FireCDEvents(CDEvent_Ready);
+	}
+	else
+	{
+		// MaxCD被改大了
+		ScheduleCD();
+	}
 }
 
 void AHeroSkill::LevelUp()
 {
 	if (CanLevelUp())
 	{
+		SyncCD();
 		CurrentLevel++;
 		if (LevelCD.Num() >= CurrentLevel)
 		{
@@ -84,6 +190,7 @@ void AHeroSkill::LevelUp()
 		{
 			CurrentCD = MaxCD;
 		}
+		ScheduleCD();
 		if (!CDing)
 		{
 			BP_SpellPassive();
@@ -98,6 +205,12 @@ bool AHeroSkill::CanLevelUp()
 
 void AHeroSkill::CheckCD(float DeltaTime)
 {
+	FireCDEvents(AdvanceCD(DeltaTime));
+}
+
+uint8 AHeroSkill::AdvanceCD(float DeltaTime)
+{
+	uint8 Events = 0;
 	if (SkillBehavior[HEROB::Channelled] && IsChannelling)
 	{
 		if (ChannellingCounting < ChannellingTime)
@@ -107,36 +220,53 @@ void AHeroSkill::CheckCD(float DeltaTime)
 			if (IntervalCounting > ChannellingInterval)
 			{
 				IntervalCounting -= ChannellingInterval;
-				if (SkillBehavior[HEROB::UnitTarget] || 
-					SkillBehavior[HEROB::UnitTargetFriends] || 
-					SkillBehavior[HEROB::UnitTargetEnemy])
-				{
-					BP_ChannellingActorInterval(Victim);
-				}
-				if (SkillBehavior[HEROB::NoTarget] || 
-					SkillBehavior[HEROB::Aoe] || 
-					SkillBehavior[HEROB::Directional])
-				{
-					BP_ChannellingInterval(CastPoint);
-				}
+				Events |= CDEvent_ChannellingInterval;
 			}
 		}
 		else
 		{
 			IsChannelling = false;
-			BP_ChannellingEnd(CastPoint);
-			BP_ChannellingActorEnd(Victim);
+			Events |= CDEvent_ChannellingEnd;
 		}
 	}
-	if (CDing)
+	// 排進時間輪的CD由OnTimerDue結束 其他的用時間戳記檢查
+	if (CDing && !CDTimer.IsValid())
 	{
-		CurrentCD += DeltaTime;
-		if (CurrentCD >= MaxCD)
+		if (GetCurrentCD() >= MaxCD)
 		{
-			BP_SpellPassive();
 			CurrentCD = MaxCD;
 			CDing = false;
+			Events |= CDEvent_Ready;
+		}
+	}
+	return Events;
+}
+
+void AHeroSkill::FireCDEvents(uint8 Events)
+{
+	if (Events & CDEvent_ChannellingInterval)
+	{
+		if (SkillBehavior[HEROB::UnitTarget] || 
+			SkillBehavior[HEROB::UnitTargetFriends] || 
+			SkillBehavior[HEROB::UnitTargetEnemy])
+		{
+			BP_ChannellingActorInterval(Victim);
 		}
+		if (SkillBehavior[HEROB::NoTarget] || 
+			SkillBehavior[HEROB::Aoe] || 
+			SkillBehavior[HEROB::Directional])
+		{
+			BP_ChannellingInterval(CastPoint);
+		}
+	}
+	if (Events & CDEvent_ChannellingEnd)
+	{
+		BP_ChannellingEnd(CastPoint);
+		BP_ChannellingActorEnd(Victim);
+	}
+	if (Events & CDEvent_Ready)
+	{
+		BP_SpellPassive();
 	}
 }
 
@@ -148,7 +278,7 @@ float AHeroSkill::GetSkillCDPercent()
 	}
 	if (CDing)
 	{
-		return CurrentCD / MaxCD;
+		return GetCurrentCD() / MaxCD;
 	}
 	// 技能學了嗎？
 	if (CurrentLevel > 0)
@@ -249,92 +379,273 @@ void AHeroSkill::SetDisplay(bool value)
 	Display = value;
 }
 
-double AHeroSkill::GetAttributesConvert(AHeroCharacter * hero, const FString& name, double v)
+double AHeroSkill::GetAttributesConvert(AHeroCharacter * hero, FName name, double v)
+{
+	// 技能自己的變數已經轉好屬性了
+	if (const int32* slot = VariableIndex.Find(name))
+	{
+		return ConvertAttribute(hero, VariableAttributes[*slot], v);
+	}
+	return ConvertAttribute(hero, ParseAttribute(name.ToString()), v);
+}
+
+void AHeroSkill::InternVariables()
+{
+	VariableIndex.Reset();
+	VariableSlots.Reset();
+	VariableAttributes.Reset();
+	for (auto& Elem : VariableMap)
+	{
+		VariableIndex.Add(FName(*Elem.Key), VariableSlots.Num());
+		VariableSlots.Add(Elem.Value);
+		VariableAttributes.Add(ParseAttribute(Elem.Key));
+	}
+}
+
+void AHeroSkill::RefreshVariables()
+{
+	InternVariables();
+	DescriptionCompiled = false;
+	DescriptionCached = false;
+}
+
+void AHeroSkill::SetDescription(const FString& Value)
+{
+	Description = Value;
+	DescriptionCompiled = false;
+	DescriptionCached = false;
+}
+
+void AHeroSkill::SetVariableMap(const TMap<FString, FLevelVariable>& Value)
+{
+	VariableMap = Value;
+	RefreshVariables();
+}
+
+int32 AHeroSkill::GetVariableSlot(FName name) const
+{
+	const int32* slot = VariableIndex.Find(name);
+	return slot ? *slot : INDEX_NONE;
+}
+
+float AHeroSkill::GetVariableBySlot(int32 slot) const
+{
+	if (CurrentLevel == 0 || !VariableSlots.IsValidIndex(slot))
+	{
+		return 0;
+	}
+	const TArray<float>& Values = VariableSlots[slot].Values;
+	return Values.IsValidIndex(CurrentLevel - 1) ? Values[CurrentLevel - 1] : 0;
+}
+
+float AHeroSkill::GetVariableByName(FName name) const
+{
+	return GetVariableBySlot(GetVariableSlot(name));
+}
+
+float AHeroSkill::GetConvertedVariableBySlot(int32 slot) const
+{
+	const float v = GetVariableBySlot(slot);
+	AHeroCharacter * hero = Cast<AHeroCharacter>(Caster);
+	if (IsValid(hero) && VariableAttributes.IsValidIndex(slot))
+	{
+		return ConvertAttribute(hero, VariableAttributes[slot], v);
+	}
+	return v;
+}
+
+ESkillAttribute AHeroSkill::ParseAttribute(const FString& name)
 {
 	//力量參數
 	if (name == TEXT("str"))
 	{
-		return v * hero->Strength;
+		return ESkillAttribute::Strength;
 	}
 	else if (name == TEXT("astr"))
 	{
-		return v * hero->AdditionStrength;
+		return ESkillAttribute::AdditionStrength;
 	}
 	else if (name == TEXT("agi"))
 	{
-		return v * hero->Agility;
+		return ESkillAttribute::Agility;
 	}
 	else if (name == TEXT("aagi"))
 	{
-		return v * hero->AdditionAgility;
+		return ESkillAttribute::AdditionAgility;
 	}
 	else if (name == TEXT("int"))
 	{
-		return v * hero->Intelligence;
+		return ESkillAttribute::Intelligence;
 	}
 	else if (name == TEXT("aint"))
 	{
-		return v * hero->AdditionIntelligence;
+		return ESkillAttribute::AdditionIntelligence;
 	}
 	else if (name == TEXT("atk"))
 	{
-		return v * hero->CurrentAttack;
+		return ESkillAttribute::Attack;
 	}
 	else if (name == TEXT("batk"))
 	{
-		return v * hero->BaseAttack;
+		return ESkillAttribute::BaseAttack;
 	}
 	else if (name == TEXT("move"))
 	{
-		return v * hero->CurrentMoveSpeed;
+		return ESkillAttribute::MoveSpeed;
 	}
 	else if (name == TEXT("armor"))
 	{
-		return v * hero->CurrentArmor;
+		return ESkillAttribute::Armor;
 	}
 	else if (name == TEXT("barmor"))
 	{
+		return ESkillAttribute::BaseArmor;
+	}
+	return ESkillAttribute::None;
+}
+
+double AHeroSkill::ConvertAttribute(AHeroCharacter * hero, ESkillAttribute attribute, double v)
+{
+	switch (attribute)
+	{
+	case ESkillAttribute::Strength:
+		return v * hero->Strength;
+	case ESkillAttribute::AdditionStrength:
+		return v * hero->AdditionStrength;
+	case ESkillAttribute::Agility:
+		return v * hero->Agility;
+	case ESkillAttribute::AdditionAgility:
+		return v * hero->AdditionAgility;
+	case ESkillAttribute::Intelligence:
+		return v * hero->Intelligence;
+	case ESkillAttribute::AdditionIntelligence:
+		return v * hero->AdditionIntelligence;
+	case ESkillAttribute::Attack:
+		return v * hero->CurrentAttack;
+	case ESkillAttribute::BaseAttack:
+		return v * hero->BaseAttack;
+	case ESkillAttribute::MoveSpeed:
+		return v * hero->CurrentMoveSpeed;
+	case ESkillAttribute::Armor:
+		return v * hero->CurrentArmor;
+	case ESkillAttribute::BaseArmor:
 		return v * hero->BaseArmor;
+	default:
+		return v;
 	}
-	return v;
+}
+
+uint32 AHeroSkill::GetDescriptionKey()
+{
+	uint32 Key = GetTypeHash(CurrentLevel);
+	AHeroCharacter * hero = Cast<AHeroCharacter>(Caster);
+	if (IsValid(hero))
+	{
+		// 只看描述有用到的屬性
+		for (int32 i = 1; i < (int32)ESkillAttribute::EndAttribute; ++i)
+		{
+			if (DescriptionAttributeMask & (1u << i))
+			{
+				Key = HashCombine(Key, GetTypeHash(ConvertAttribute(hero, (ESkillAttribute)i, 1)));
+			}
+		}
+	}
+	return Key;
+}
+
+void AHeroSkill::CompileDescription()
+{
+	InternVariables();
+	DescriptionLiterals.Reset();
+	DescriptionSlots.Reset();
+	DescriptionAttributeMask = 0;
+	DescriptionCompiled = true;
+	DescriptionCached = false;
+
+	// 跟FString::Format一樣 {Name}換成變數 `{ `} 是大括號本身 找不到的變數原樣保留
+	FString Literal;
+	const int32 Len = Description.Len();
+	for (int32 i = 0; i < Len; ++i)
+	{
+		const TCHAR c = Description[i];
+		if (c == TEXT('`') && i + 1 < Len && (Description[i + 1] == TEXT('{') || Description[i + 1] == TEXT('}')))
+		{
+			Literal.AppendChar(Description[++i]);
+			continue;
+		}
+		if (c == TEXT('{'))
+		{
+			const int32 End = Description.Find(TEXT("}"), ESearchCase::CaseSensitive, ESearchDir::FromStart, i + 1);
+			if (End != INDEX_NONE)
+			{
+				const int32 Slot = GetVariableSlot(FName(*Description.Mid(i + 1, End - i - 1)));
+				if (Slot != INDEX_NONE)
+				{
+					DescriptionAttributeMask |= 1u << (uint32)VariableAttributes[Slot];
+					DescriptionLiterals.Add(Literal);
+					DescriptionSlots.Add(Slot);
+					Literal.Reset();
+					i = End;
+					continue;
+				}
+			}
+		}
+		Literal.AppendChar(c);
+	}
+	DescriptionLiterals.Add(Literal);
 }
 
 FString AHeroSkill::GetDescription()
 {
-	TMap<FString, FStringFormatArg> FormatMap;
+	// 描述跟變數只會經過Setter修改 不用每次比對字串
+	if (!DescriptionCompiled)
+	{
+		CompileDescription();
+	}
+	// 等級跟屬性沒變就用上次的結果
+	const uint32 Key = GetDescriptionKey();
+	if (DescriptionCached && Key == CachedDescriptionKey)
+	{
+		return CachedDescription;
+	}
 	int ShowIndex = CurrentLevel - 1;
 	if (ShowIndex < 0)
 	{
 		ShowIndex = 0;
 	}
 	AHeroCharacter * hero = Cast<AHeroCharacter>(Caster);
-	for (auto& Elem : VariableMap)
+	CachedDescription.Reset();
+	for (int32 i = 0; i < DescriptionSlots.Num(); ++i)
 	{
-		double v = Elem.Value[ShowIndex];
+		CachedDescription.Append(DescriptionLiterals[i]);
+		const int32 Slot = DescriptionSlots[i];
+		const TArray<float>& Values = VariableSlots[Slot].Values;
+		double v = Values.IsValidIndex(ShowIndex) ? Values[ShowIndex] : 0;
 		if (IsValid(hero))
 		{
-			v = GetAttributesConvert(hero, Elem.Key, v);
+			v = ConvertAttribute(hero, VariableAttributes[Slot], v);
 		}
 		double m1 = v - floor(v);
 		double m01 = v - floor(v * 10)*0.1;
-		FString value;
+		TCHAR value[64];
 		if (m1 < 0.01)
 		{
-			value = FString::Printf(TEXT("%.f"), v);
-			
+			FCString::Snprintf(value, ARRAY_COUNT(value), TEXT("%.f"), v);
 		}
 		else if (m01 < 0.01)
 		{
-			value = FString::Printf(TEXT("%.1f"), v);
+			FCString::Snprintf(value, ARRAY_COUNT(value), TEXT("%.1f"), v);
 		}
 		else
 		{
-			value = FString::Printf(TEXT("%.2f"), v);
+			FCString::Snprintf(value, ARRAY_COUNT(value), TEXT("%.2f"), v);
 		}
-		FormatMap.Add(Elem.Key, FStringFormatArg(value));
+		CachedDescription.Append(value);
 	}
-	FString Text = FString::Format(*Description, FormatMap);
-	return Text;
+	CachedDescription.Append(DescriptionLiterals.Last());
+	CachedDescriptionKey = Key;
+	DescriptionCached = true;
+	return CachedDescription;
 }
 
 #if WITH_EDITOR
@@ -353,6 +664,9 @@ void AHeroSkill::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEv
 		CurrentCD = MaxCD;
 	}
 	MaxLevel = LevelCD.Num();
+	InternVariables();
+	DescriptionCompiled = false;
+	DescriptionCached = false;
 	Super::PostEditChangeProperty(PropertyChangedEvent);
 }
 
@@ -363,6 +677,8 @@ void AHeroSkill::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLife
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 	DOREPLIFETIME(AHeroSkill, CDing);
 	DOREPLIFETIME(AHeroSkill, CurrentCD);
+	DOREPLIFETIME(AHeroSkill, CDStartTime);
+	DOREPLIFETIME(AHeroSkill, CDTimeRate);
 	DOREPLIFETIME(AHeroSkill, CurrentLevel);
 	DOREPLIFETIME(AHeroSkill, CurrnetManaCost);
 	DOREPLIFETIME(AHeroSkill, Enable);
@@ -6,6 +6,7 @@
 #include "GameFramework/Actor.h"
 #include "SkillHintActor.h"
 #include "HeroBuff.h"
+#include "TimerWheel.h"
 #include "HeroSkill.generated.h"
 
 UENUM(BlueprintType)
@@ -59,6 +60,38 @@ enum class EHeroBehavior : uint8
 };
 #define HEROB EHeroBehavior
 
+// 技能變數名稱對應的英雄屬性 載入時從字串轉成列舉
+enum class ESkillAttribute : uint8
+{
+	//不換算
+	None,
+	//str 力量
+	Strength,
+	//astr 外加力量
+	AdditionStrength,
+	//agi 敏捷
+	Agility,
+	//aagi 外加敏捷
+	AdditionAgility,
+	//int 智力
+	Intelligence,
+	//aint 外加智力
+	AdditionIntelligence,
+	//atk 攻擊力
+	Attack,
+	//batk 基礎攻擊力
+	BaseAttack,
+	//move 移動速度
+	MoveSpeed,
+	//armor 防禦力
+	Armor,
+	//barmor 基礎防禦力
+	BaseArmor,
+	//結束列舉
+	EndAttribute
+};
+
+
 UCLASS()
 class AON_API AHeroSkill : public AActor
 {
@@ -73,7 +106,14 @@ protected:
 	virtual void BeginPlay() override;
 
 public:
-	double GetAttributesConvert(class AHeroCharacter * hero, const FString& name, double v);
+	// 常用的變數先用GetVariableSlot查好編號 再用GetConvertedVariableBySlot
+	double GetAttributesConvert(class AHeroCharacter * hero, FName name, double v);
+
+	//變數名稱轉成屬性列舉 只在編譯描述時用
+	static ESkillAttribute ParseAttribute(const FString& name);
+
+	//依屬性換算數值
+	static double ConvertAttribute(class AHeroCharacter * hero, ESkillAttribute attribute, double v);
 
 	//被動技發動
 	//發動時機：CD ready時，剛點技能時，CD中則不發動
@@ -147,6 +187,28 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "MOBA|Skill")
 	void EndCD();
 
+	//CD不再每個Frame累積 讀取時用CDStartTime算出經過的時間
+	UFUNCTION(BlueprintGetter)
+	float GetCurrentCD() const;
+
+	UFUNCTION(BlueprintSetter)
+	void SetCurrentCD(float Value);
+
+	UFUNCTION(BlueprintSetter)
+	void SetCDing(bool Value);
+
+	UFUNCTION(BlueprintSetter)
+	void SetMaxCD(float Value);
+
+	//把經過的CD時間寫回CurrentCD
+	void SyncCD();
+
+	//CD結束的時間交給時間輪 沒有管理者或不是伺服器時由AdvanceCD檢查
+	void ScheduleCD();
+
+	//時間輪叫醒 不是目前的handle就忽略
+	void OnTimerDue(const FTimerWheelHandle& Handle);
+
 	//技能強制升級
 	UFUNCTION(BlueprintCallable, Category = "MOBA|Skill")
 	void LevelUp();
@@ -158,6 +220,12 @@ public:
 	//累積技能CD時間
 	void CheckCD(float DeltaTime);
 
+	//只累積時間不呼叫藍圖 回傳要觸發的事件
+	uint8 AdvanceCD(float DeltaTime);
+
+	//觸發AdvanceCD回傳的事件
+	void FireCDEvents(uint8 Events);
+
 	//得到當前CD百分比
 	float GetSkillCDPercent();
 
@@ -185,6 +253,32 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "MOBA|Skill")
 	float GetVariable(FString name);
 
+	//得到變數的編號 在藍圖BeginPlay存起來 之後用GetVariableBySlot就不用再查字串
+	UFUNCTION(BlueprintPure, Category = "MOBA|Skill")
+	int32 GetVariableSlot(FName name) const;
+
+	//用編號得到當前等級的變數
+	UFUNCTION(BlueprintPure, Category = "MOBA|Skill")
+	float GetVariableBySlot(int32 slot) const;
+
+	//用FName得到當前等級的變數
+	UFUNCTION(BlueprintPure, Category = "MOBA|Skill")
+	float GetVariableByName(FName name) const;
+
+	//用編號得到當前等級的變數 依變數名稱乘上英雄屬性
+	UFUNCTION(BlueprintPure, Category = "MOBA|Skill")
+	float GetConvertedVariableBySlot(int32 slot) const;
+
+	//藍圖直接改VariableMap裡面的值要呼叫這個重新建立編號 整個設定會自動呼叫
+	UFUNCTION(BlueprintCallable, Category = "MOBA|Skill")
+	void RefreshVariables();
+
+	//修改描述或變數都要重新編譯描述
+	UFUNCTION(BlueprintSetter)
+	void SetDescription(const FString& Value);
+	UFUNCTION(BlueprintSetter)
+	void SetVariableMap(const TMap<FString, FLevelVariable>& Value);
+
 	//目前是否可以使用技能
 	UFUNCTION(BlueprintCallable, Category = "MOBA|Skill")
 	bool IsEnable();
@@ -260,7 +354,7 @@ public:
 	//與指定部隊交換位置並且造成(50/100/150/200)點傷害，並且讓敵人暈頭轉向暈眩(1/1.5/2/2.5)秒，施展距離(600/700/800/900)。
 	//與指定部隊交換位置並且造成{Damage}點傷害，並且讓敵人暈頭轉向暈眩{Duration}秒，施展距離{CastRange}。
 	//然後像是CD跟法力消耗有固定的，沒有固定的就從Variable Map中去找，抓不到值就填 -999
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "MOBA", meta = (MultiLine = "true"))
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetDescription, Category = "MOBA", meta = (MultiLine = "true"))
 	FString Description;
 
 	//技能圖片
@@ -279,6 +373,14 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "MOBA")
 	TArray<float> ManaCost;
 
+	//AdvanceCD回傳的事件
+	enum ECDEvent : uint8
+	{
+		CDEvent_ChannellingInterval = 1,
+		CDEvent_ChannellingEnd = 2,
+		CDEvent_Ready = 4,
+	};
+
 	//儲存每個等級的生命消耗
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "MOBA")
 	TArray<float> HpCost;
@@ -287,18 +389,29 @@ public:
 	float CurrnetManaCost;
 
 	//是否在CD中
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Current", Replicated)
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetCDing, Category = "Current", Replicated)
 	bool CDing;
 
 	//當前CD秒數，CD秒數等於Skill_MaxCD時就是CD結束
-	//Skill_CurrentCD will accumulation every frame
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Current", Replicated)
+	//CDing時是CDStartTime當下的值 只在事件時改變 要用GetCurrentCD讀
+	UPROPERTY(EditAnywhere, BlueprintGetter = GetCurrentCD, BlueprintSetter = SetCurrentCD, Category = "Current", Replicated)
 	float CurrentCD;
 
 	//當前技能CD時間
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Current", Replicated)
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetMaxCD, Category = "Current", Replicated)
 	float MaxCD;
 
+	//CD結束的時間輪事件
+	FTimerWheelHandle CDTimer;
+
+	//CurrentCD是這個伺服器時間的值 用戶端自己推算現在的CD
+	UPROPERTY(Replicated)
+	float CDStartTime = 0;
+
+	//CDStartTime之後的時間倍率 施法者的CustomTimeDilation不同步 用戶端用這個算
+	UPROPERTY(Replicated)
+	float CDTimeRate = 1;
+
 	//CD倍率 0.9就是-10% CD
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Current")
 	float CDRatio = 1;
@@ -331,7 +444,34 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Current")
 	int32 MaxLevel;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA")
+	UPROPERTY(EditAnywhere, BlueprintSetter = SetVariableMap, Category = "MOBA")
 	TMap<FString, FLevelVariable> VariableMap;
+
+	// 描述用到的等級跟英雄屬性 有變描述才要重做
+	uint32 GetDescriptionKey();
+
+	// 把VariableMap轉成編號 變數名稱對應的屬性也在這裡決定
+	void InternVariables();
+
+	// 變數編號 VariableSlots VariableAttributes 同一個index
+	TMap<FName, int32> VariableIndex;
+	TArray<FLevelVariable> VariableSlots;
+	TArray<ESkillAttribute> VariableAttributes;
+
+	// 把Description拆成文字段跟變數 只在Description或VariableMap改變時做 會先重建變數編號
+	void CompileDescription();
+
+	// 編譯後的描述 DescriptionLiterals比DescriptionSlots多一段
+	// DescriptionSlots是變數編號
+	TArray<FString> DescriptionLiterals;
+	TArray<int32> DescriptionSlots;
+	// 描述有用到的屬性
+	uint32 DescriptionAttributeMask = 0;
+	bool DescriptionCompiled = false;
+
+	// 格式化之後的描述快取
+	FString CachedDescription;
+	uint32 CachedDescriptionKey = 0;
+	bool DescriptionCached = false;
 	
 };
@@ -18,6 +18,9 @@
 #include "Equipment.h"
 #include "HeroSkill.h"
 #include "BasicUnit.h"
+#include "WebInterface.h"
+#include "WebInterfaceJSON.h"
+#include "SceneView.h"
 
 
 AMHUD::AMHUD(const FObjectInitializer& ObjectInitializer)
@@ -70,7 +73,11 @@ void AMHUD::Tick(float DeltaSeconds)
 		}
 		RemoveSelection.Empty();
 	}
-	if (CurrentSelection.Num() > 0)
+	if (IsValid(WebUI))
+	{
+		PushHeroSnapshot(CurrentSelection.Num() > 0 ? CurrentSelection[0] : nullptr);
+	}
+	else if (CurrentSelection.Num() > 0)
 	{
 		if (IsValid(CurrentSelection[0]))
 		{
@@ -83,78 +90,333 @@ void AMHUD::Tick(float DeltaSeconds)
 
 		UpdateHeroData(0);
 	}
+	// 藍圖的hitbox每個Frame重加
 	MOBA_CleanHitBox();
-	FString JsonString = GetUIRegion();
-	TSharedRef< TJsonReader<> > Reader = TJsonReaderFactory<>::Create(*JsonString);
+	OnSize();
+	if (!UIRegionPushed)
+	{
+		SetUIRegionJson(GetUIRegion());
+	}
+	if (ViewportScale != UIRegionScale)
+	{
+		ApplyUIRegions();
+	}
+}
+
+void AMHUD::SetUIRegions(const TArray<FUIRegion>& Regions)
+{
+	UIRegions = Regions;
+	UIRegionVersion++;
+	ApplyUIRegions();
+}
+
+void AMHUD::SetUIRegionJson(const FString& JsonString)
+{
+	if (JsonString == LastUIRegionJson)
+	{
+		return;
+	}
+	LastUIRegionJson = JsonString;
+	TSharedRef< TJsonReader<> > Reader = TJsonReaderFactory<>::Create(JsonString);
 	TSharedPtr<FJsonObject> JsonObj;
-	float s = 1.0 / ViewportScale;
+	TArray<FUIRegion> Regions;
 	if (FJsonSerializer::Deserialize(Reader, JsonObj) && JsonObj.IsValid())
 	{
 		TArray <TSharedPtr<FJsonValue>> zonesJs = JsonObj->GetArrayField("data");
 		for (int itZones = 0; itZones != zonesJs.Num(); itZones++) {
 			TSharedPtr<FJsonObject> temp = zonesJs[itZones]->AsObject();
-			FString id;
+			FUIRegion& Region = Regions[Regions.AddDefaulted()];
 			double x = 0, y = 0, w = 0, h = 0;
-			temp->TryGetStringField(FString(TEXT("id")), id);
+			temp->TryGetStringField(FString(TEXT("id")), Region.Id);
 			temp->TryGetNumberField(FString(TEXT("x")), x);
 			temp->TryGetNumberField(FString(TEXT("y")), y);
 			temp->TryGetNumberField(FString(TEXT("w")), w);
 			temp->TryGetNumberField(FString(TEXT("h")), h);
-			MOBA_AddHitBox(FVector2D(x*s, y*s), FVector2D(w*s, h*s), id, 0, false);
+			Region.Position = FVector2D(x, y);
+			Region.Size = FVector2D(w, h);
 		}
 	}
-	OnSize();
+	SetUIRegions(Regions);
+}
+
+void AMHUD::OnWebInterfaceEvent(const FName Name, UWebInterfaceJsonValue* Data)
+{
+	static const FName UpdateUIRegionName(TEXT("UpdateUIRegion"));
+	if (Name == UpdateUIRegionName && Data && Data->GetType() == EWebInterfaceJsonType::String)
+	{
+		UIRegionPushed = true;
+		SetUIRegionJson(Data->GetString());
+	}
+}
+
+void AMHUD::ApplyUIRegions()
+{
+	UIRegionScale = ViewportScale;
+	UIRegionHitBoxes.Reset();
+	float s = 1.0 / ViewportScale;
+	for (const FUIRegion& Region : UIRegions)
+	{
+		UIRegionHitBoxes.Add(FMHitBox(Region.Position * s, Region.Size * s, Region.Id, false, 0));
+	}
+	RebuildHitBoxMap();
+}
+
+void AMHUD::RebuildHitBoxMap()
+{
+	// UI區域都是優先權0 照順序放就好
+	MOBA_HitBoxMap = UIRegionHitBoxes;
+	for (const FMHitBox& HitBox : BlueprintHitBoxes)
+	{
+		InsertHitBox(HitBox);
+	}
+	HitBoxLookupDirty = true;
+}
+
+void AMHUD::SetWebInterface(UWebInterface* wi)
+{
+	if (IsValid(WebUI))
+	{
+		WebUI->OnInterfaceEvent.RemoveDynamic(this, &AMHUD::OnWebInterfaceEvent);
+	}
+	WebUI = wi;
+	if (IsValid(WebUI))
+	{
+		// 版面改變時網頁會broadcast UpdateUIRegion
+		WebUI->OnInterfaceEvent.AddUniqueDynamic(this, &AMHUD::OnWebInterfaceEvent);
+	}
+	LastSnapshotUnit = nullptr;
+	LastHeroSnapshot.Reset();
+	LastHeroText.Reset();
+	// base64每3個byte變4個字元 技能Buff多的單位會再長大 Reset不會釋放
+	SnapshotScript.Reserve(1024);
+}
+
+void AMHUD::PushHeroSnapshot(ABasicUnit* hero)
+{
+	if (!IsValid(hero))
+	{
+		if (LastSnapshotUnit)
+		{
+			LastSnapshotUnit = nullptr;
+			WebUI->Execute(TEXT("ue.interface.hideProgress()"));
+		}
+		return;
+	}
+	HeroSnapshot.Capture(hero);
+	const bool NewUnit = LastSnapshotUnit != hero;
+	// 名稱圖片描述很少變 簽章不同才重新讀取 只送有變的key
+	if (NewUnit || HeroSnapshot.TextSignature != LastHeroSnapshot.TextSignature)
+	{
+		HeroText.Capture(hero);
+		SnapshotScript.Reset();
+		SnapshotScript.Append(TEXT("ue.interface.patchUnit("));
+		if (HeroText.AppendPatch(SnapshotScript, LastHeroText))
+		{
+			SnapshotScript.AppendChar(TEXT(')'));
+			WebUI->Execute(SnapshotScript);
+			Swap(HeroText, LastHeroText);
+		}
+	}
+	if (NewUnit || !HeroSnapshot.SameValues(LastHeroSnapshot))
+	{
+		SnapshotScript.Reset();
+		SnapshotScript.Append(TEXT("ue.interface.setUnitBinary('"));
+		HeroSnapshot.AppendBase64(SnapshotScript);
+		SnapshotScript.Append(TEXT("')"));
+		WebUI->Execute(SnapshotScript);
+	}
+	LastSnapshotUnit = hero;
+	Swap(HeroSnapshot, LastHeroSnapshot);
 }
 
 ABasicUnit* AMHUD::GetMouseTarget(float MinDistance)
 {
-	MinDistance = MinDistance*MinDistance;
-	ABasicUnit* res = nullptr;
-	float mindis = MinDistance;
-	for (ABasicUnit* EachHero : HeroCanSelection)
+	// 用上次DrawHUD投影的座標 畫面外的單位點不到
+	int32 Index = ScreenGrid.FindNearest(ScreenUnits, CurrentMouseXY, MinDistance);
+	if (Index != INDEX_NONE && IsValid(ScreenUnits[Index].Unit))
 	{
-		FVector pos = this->Project(EachHero->GetActorLocation());
-		EachHero->ScreenPosition.X = pos.X;
-		EachHero->ScreenPosition.Y = pos.Y;
-		float dis = FVector2D::DistSquared(CurrentMouseXY, EachHero->ScreenPosition);
-		if (dis < MinDistance && dis < mindis)
+		return ScreenUnits[Index].Unit;
+	}
+	return nullptr;
+}
+
+void FScreenGrid::Build(const TArray<FUnitScreenInfo>& Units, float Width, float Height)
+{
+	Cols = FMath::Max(1, FMath::CeilToInt(Width / CellSize));
+	Rows = FMath::Max(1, FMath::CeilToInt(Height / CellSize));
+	const int32 CellCount = Cols * Rows;
+	CellStart.Reset();
+	CellStart.AddZeroed(CellCount + 1);
+	// 畫面外一點的單位夾到邊上的格子
+	for (const FUnitScreenInfo& Info : Units)
+	{
+		CellStart[CellY(Info.Center.Y) * Cols + CellX(Info.Center.X) + 1]++;
+	}
+	for (int32 i = 0; i < CellCount; ++i)
+	{
+		CellStart[i + 1] += CellStart[i];
+	}
+	Items.SetNumUninitialized(Units.Num());
+	TArray<int32, TInlineAllocator<256>> Fill;
+	Fill.Append(CellStart.GetData(), CellCount);
+	for (int32 i = 0; i < Units.Num(); ++i)
+	{
+		Items[Fill[CellY(Units[i].Center.Y) * Cols + CellX(Units[i].Center.X)]++] = i;
+	}
+}
+
+int32 FScreenGrid::FindNearest(const TArray<FUnitScreenInfo>& Units, const FVector2D& Pos, float MaxDistance) const
+{
+	if (Items.Num() == 0)
+	{
+		return INDEX_NONE;
+	}
+	int32 res = INDEX_NONE;
+	float mindis = MaxDistance * MaxDistance;
+	const int32 X0 = CellX(Pos.X - MaxDistance), X1 = CellX(Pos.X + MaxDistance);
+	const int32 Y0 = CellY(Pos.Y - MaxDistance), Y1 = CellY(Pos.Y + MaxDistance);
+	for (int32 y = Y0; y <= Y1; ++y)
+	{
+		for (int32 x = X0; x <= X1; ++x)
 		{
-			mindis = dis;
-			res = EachHero;
+			const int32 Cell = y * Cols + x;
+			for (int32 i = CellStart[Cell]; i < CellStart[Cell + 1]; ++i)
+			{
+				float dis = FVector2D::DistSquared(Pos, Units[Items[i]].Center);
+				// 距離一樣時跟原本的線性搜尋一樣取index小的
+				if (dis < mindis || (dis == mindis && res != INDEX_NONE && Items[i] < res))
+				{
+					mindis = dis;
+					res = Items[i];
+				}
+			}
 		}
 	}
 	return res;
 }
 
+void FScreenGrid::QueryRect(const FVector2D& Min, const FVector2D& Max, TArray<int32>& Out) const
+{
+	Out.Reset();
+	if (Items.Num() == 0)
+	{
+		return;
+	}
+	const int32 X0 = CellX(Min.X), X1 = CellX(Max.X);
+	const int32 Y0 = CellY(Min.Y), Y1 = CellY(Max.Y);
+	for (int32 y = Y0; y <= Y1; ++y)
+	{
+		const int32 Begin = CellStart[y * Cols + X0];
+		const int32 End = CellStart[y * Cols + X1 + 1];
+		// 同一列的格子在Items裡是連續的
+		Out.Append(Items.GetData() + Begin, End - Begin);
+	}
+}
+
+void AMHUD::UpdateBoxSelection()
+{
+	if (!BoxSelecting)
+	{
+		// 開始框選 之前選的單位也要跟框比對
+		BoxSelecting = true;
+		BoxSelection.Reset();
+		for (ABasicUnit* EachHero : CurrentSelection)
+		{
+			if (IsValid(EachHero) && EachHero->isSelection)
+			{
+				BoxSelection.Add(EachHero);
+			}
+		}
+	}
+	FVector2D BoxMin(std::min(InitialMouseXY.X, CurrentMouseXY.X), std::min(InitialMouseXY.Y, CurrentMouseXY.Y));
+	FVector2D BoxMax(std::max(InitialMouseXY.X, CurrentMouseXY.X), std::max(InitialMouseXY.Y, CurrentMouseXY.Y));
+	ScreenGrid.QueryRect(BoxMin, BoxMax, BoxQuery);
+	NextBoxSelection.Reset();
+	for (int32 Index : BoxQuery)
+	{
+		const FUnitScreenInfo& Info = ScreenUnits[Index];
+		// 只選活人
+		if (Info.Unit->IsAlive && CheckInSelectionBox(Info.Center))
+		{
+			NextBoxSelection.Add(Info.Unit);
+			if (!Info.Unit->isSelection)
+			{
+				Info.Unit->SelectionOn();
+			}
+		}
+	}
+	// 離開框的單位 畫面外的單位也不會在框裡
+	for (ABasicUnit* EachHero : BoxSelection)
+	{
+		if (IsValid(EachHero) && EachHero->IsAlive && EachHero->isSelection && !NextBoxSelection.Contains(EachHero))
+		{
+			EachHero->SelectionOff();
+		}
+	}
+	Swap(BoxSelection, NextBoxSelection);
+}
+
+void AMHUD::UpdateScreenUnits()
+{
+	ScreenUnits.Reset();
+	ScreenStamp++;
+	if (!Canvas)
+	{
+		ScreenGrid.Build(ScreenUnits, 0, 0);
+		return;
+	}
+	const FSceneView* View = Canvas->SceneView;
+	for (ABasicUnit* EachHero : HeroCanSelection)
+	{
+		if (!IsValid(EachHero))
+		{
+			continue;
+		}
+		const FVector Location = EachHero->GetActorLocation();
+		if (View && !View->ViewFrustum.IntersectSphere(Location, ScreenCullRadius))
+		{
+			continue;
+		}
+		FUnitScreenInfo& Info = ScreenUnits[ScreenUnits.AddUninitialized()];
+		Info.Unit = EachHero;
+		Info.Center = FVector2D(Project(Location));
+		if (EachHero->IsAlive)
+		{
+			Info.Head = FVector2D(Project(EachHero->PositionOnHead->GetComponentLocation()));
+			Info.Foot = FVector2D(Project(EachHero->PositionUnderFoot->GetComponentLocation()));
+		}
+		else
+		{
+			Info.Head = Info.Foot = Info.Center;
+		}
+		EachHero->ScreenPosition = Info.Center;
+		EachHero->ScreenStamp = ScreenStamp;
+	}
+	ScreenGrid.Build(ScreenUnits, Canvas->ClipX, Canvas->ClipY);
+}
+
 void AMHUD::DrawHUD()
 {
 	Super::DrawHUD();
+	for (int i = 0; i < HeroCanSelection.Num(); ++i)
+	{
+		if (HeroCanSelection[i] == NULL)
+		{
+			HeroCanSelection.RemoveAt(i);
+			i--;
+		}
+	}
+	UpdateScreenUnits();
 	
 	// 畫多選的box
+	bool DrawingBox = false;
 	if(HUDStatus == EMHUDStatus::Normal && bMouseLButton && IsGameRegion(CurrentMouseXY))
 	{
 		// selection box
 		if(FVector2D::DistSquared(InitialMouseXY, CurrentMouseXY) > 25)
 		{
-			for(ABasicUnit* EachHero : HeroCanSelection)
-			{
-				// 只選活人
-				if (EachHero->IsAlive)
-				{
-					FVector pos = this->Project(EachHero->GetActorLocation());
-					EachHero->ScreenPosition.X = pos.X;
-					EachHero->ScreenPosition.Y = pos.Y;
-					bool res = CheckInSelectionBox(EachHero->ScreenPosition);
-					if (res && !EachHero->isSelection)
-					{
-						EachHero->SelectionOn();
-					}
-					else if (!res && EachHero->isSelection)
-					{
-						EachHero->SelectionOff();
-					}
-				}
-			}
+			DrawingBox = true;
+			UpdateBoxSelection();
 
 			float maxX, maxY;
 			float minX, minY;
@@ -170,13 +432,10 @@ void AMHUD::DrawHUD()
 			DrawRect(SelectionBoxFillColor, minX, minY, maxX - minX - 1, maxY - minY - 1);
 		}
 	}
-	for (int i = 0; i < HeroCanSelection.Num(); ++i)
+	if (!DrawingBox && BoxSelecting)
 	{
-		if (HeroCanSelection[i] == NULL)
-		{
-			HeroCanSelection.RemoveAt(i);
-			i--;
-		}
+		BoxSelecting = false;
+		BoxSelection.Reset();
 	}
 	for (int32 Index = 0; Index < MOBA_HitBoxMap.Num(); ++Index)
 	{
@@ -184,20 +443,16 @@ void AMHUD::DrawHUD()
 			MOBA_HitBoxMap[Index].Coords.X*ViewportScale, MOBA_HitBoxMap[Index].Coords.Y*ViewportScale,
 			MOBA_HitBoxMap[Index].Size.X*ViewportScale, MOBA_HitBoxMap[Index].Size.Y*ViewportScale);
 	}
-	for(ABasicUnit* EachHero : HeroCanSelection)
+	for (const FUnitScreenInfo& Info : ScreenUnits)
 	{
-		if (!IsValid(EachHero))
-		{
-			EachHero->Destroy();
-			continue;
-		}
+		ABasicUnit* EachHero = Info.Unit;
 		// 只畫活人的血條
 		if (!EachHero->IsAlive)
 		{
 			continue;
 		}
-		FVector2D headpos = FVector2D(this->Project(EachHero->PositionOnHead->GetComponentLocation()));
-		FVector2D footpos = FVector2D(this->Project(EachHero->PositionUnderFoot->GetComponentLocation()));
+		FVector2D headpos = Info.Head;
+		FVector2D footpos = Info.Foot;
 		footpos.Y += 35;
 		float  hpBarLength = EachHero->HPBarLength;
 		float  halfHPBarLength = hpBarLength * .5f;
@@ -212,12 +467,12 @@ void AMHUD::DrawHUD()
 		float ShieldPhysicalLen = hpBarLength * (EachHero->GetShieldPhysicalPercent() / HPPersent);
 		float ShieldMagicalLen = hpBarLength * (EachHero->GetShieldMagicalPercent() / HPPersent);
 		//畫HP
-		DrawRect(HPBarBackColor, headpos.X - halfHPBarLength - 1, headpos.Y - 1, hpBarLength + 2, HPBarHeight + 2);
-		DrawRect(HPBarForeColor, headpos.X - halfHPBarLength, headpos.Y, HPLen, HPBarHeight);
+		AddBarRect(HPBarBackColor, headpos.X - halfHPBarLength - 1, headpos.Y - 1, hpBarLength + 2, HPBarHeight + 2);
+		AddBarRect(HPBarForeColor, headpos.X - halfHPBarLength, headpos.Y, HPLen, HPBarHeight);
 		//畫通用護盾
-		DrawRect(ShieldColor, headpos.X - halfHPBarLength + HPLen, headpos.Y, ShieldLen, HPBarHeight);
-		DrawRect(ShieldPhysicalColor, headpos.X - halfHPBarLength + HPLen, headpos.Y- HPBarHeight, ShieldPhysicalLen, HPBarHeight);
-		DrawRect(ShieldMagicalColor, headpos.X - halfHPBarLength + HPLen, headpos.Y- HPBarHeight*2, ShieldMagicalLen, HPBarHeight);
+		AddBarRect(ShieldColor, headpos.X - halfHPBarLength + HPLen, headpos.Y, ShieldLen, HPBarHeight);
+		AddBarRect(ShieldPhysicalColor, headpos.X - halfHPBarLength + HPLen, headpos.Y- HPBarHeight, ShieldPhysicalLen, HPBarHeight);
+		AddBarRect(ShieldMagicalColor, headpos.X - halfHPBarLength + HPLen, headpos.Y- HPBarHeight*2, ShieldMagicalLen, HPBarHeight);
 
 		//畫角色名字
 		DrawText(EachHero->UnitName, FLinearColor(1, 1, 1), footpos.X - EachHero->UnitName.Len()*.5f * 15, footpos.Y, NULL, EachHero->UnitNameDrawSize);
@@ -228,7 +483,7 @@ void AMHUD::DrawHUD()
 			for(float i = 100; i < maxhp; i += 100)
 			{
 				float xpos = headpos.X - halfHPBarLength + hpBarLength * (i / maxhp);
-				DrawLine(xpos, headpos.Y, xpos, headpos.Y + HPBarHeight, HPBarBackColor);
+				AddBarRect(HPBarBackColor, xpos, headpos.Y, 1, HPBarHeight);
 			}
 		}
 		else
@@ -236,21 +491,21 @@ void AMHUD::DrawHUD()
 			for(float i = 500; i < maxhp; i += 500)
 			{
 				float xpos = headpos.X - halfHPBarLength + hpBarLength * (i / maxhp);
-				DrawRect(HPBarBackColor, xpos, headpos.Y, 3, HPBarHeight);
+				AddBarRect(HPBarBackColor, xpos, headpos.Y, 3, HPBarHeight);
 			}
 		}
 
 		//畫MP
 		headpos.Y += HPBarHeight + 1;
-		DrawRect(MPBarBackColor, headpos.X - halfHPBarLength - 1, headpos.Y - 1, hpBarLength + 2, HPBarHeight + 2);
-		DrawRect(MPBarForeColor, headpos.X - halfHPBarLength, headpos.Y, hpBarLength * EachHero->GetMPPercent(), HPBarHeight);
+		AddBarRect(MPBarBackColor, headpos.X - halfHPBarLength - 1, headpos.Y - 1, hpBarLength + 2, HPBarHeight + 2);
+		AddBarRect(MPBarForeColor, headpos.X - halfHPBarLength, headpos.Y, hpBarLength * EachHero->GetMPPercent(), HPBarHeight);
 		float maxmp = EachHero->CurrentMaxMP;
 		if (maxmp < 1500)
 		{
 			for (float i = 100; i < maxmp; i += 100)
 			{
 				float xpos = headpos.X - halfHPBarLength + hpBarLength * (i / maxmp);
-				DrawLine(xpos, headpos.Y, xpos, headpos.Y + HPBarHeight, MPBarBackColor);
+				AddBarRect(MPBarBackColor, xpos, headpos.Y, 1, HPBarHeight);
 			}
 		}
 		else
@@ -258,10 +513,50 @@ void AMHUD::DrawHUD()
 			for (float i = 500; i < maxmp; i += 500)
 			{
 				float xpos = headpos.X - halfHPBarLength + hpBarLength * (i / maxmp);
-				DrawRect(MPBarBackColor, xpos, headpos.Y, 3, HPBarHeight);
+				AddBarRect(MPBarBackColor, xpos, headpos.Y, 3, HPBarHeight);
 			}
 		}
 	}
+	FlushBars();
+	DamageNumbers.Update(RenderDelta);
+	DamageNumbers.Draw(Canvas);
+}
+
+void AMHUD::AddDamageNumber(const ADamageEffect* Style, const FVector& pos, const FVector& dir, int32 Damage)
+{
+	DamageNumbers.Add(Style, pos, dir, Damage);
+}
+
+void AMHUD::AddBarRect(const FLinearColor& Color, float X, float Y, float W, float H)
+{
+	if (W <= 0 || H <= 0)
+	{
+		return;
+	}
+	// 一個矩形兩個三角形 貼圖用白色 顏色放在頂點上
+	FCanvasUVTri* Tri = &BarTriangles[BarTriangles.AddUninitialized(2)];
+	Tri[0].V0_Pos = FVector2D(X, Y);
+	Tri[0].V1_Pos = FVector2D(X + W, Y);
+	Tri[0].V2_Pos = FVector2D(X + W, Y + H);
+	Tri[1].V0_Pos = FVector2D(X, Y);
+	Tri[1].V1_Pos = FVector2D(X + W, Y + H);
+	Tri[1].V2_Pos = FVector2D(X, Y + H);
+	for (int32 i = 0; i < 2; ++i)
+	{
+		Tri[i].V0_UV = Tri[i].V1_UV = Tri[i].V2_UV = FVector2D::ZeroVector;
+		Tri[i].V0_Color = Tri[i].V1_Color = Tri[i].V2_Color = Color;
+	}
+}
+
+void AMHUD::FlushBars()
+{
+	if (BarTriangles.Num() > 0 && Canvas)
+	{
+		FCanvasTriangleItem TriItem(BarTriangles, GWhiteTexture);
+		TriItem.BlendMode = SE_BLEND_Translucent;
+		Canvas->DrawItem(TriItem);
+	}
+	BarTriangles.Reset();
 }
 
 bool AMHUD::CheckInSelectionBox(FVector2D pos)
@@ -296,50 +591,146 @@ void AMHUD::ClearAllSelection()
 
 FMHitBox* AMHUD::FindHitBoxByName(const FString& name)
 {
-	for(int32 Index = 0; Index < MOBA_HitBoxMap.Num(); ++Index)
+	if (HitBoxLookupDirty)
+	{
+		RebuildHitBoxLookup();
+	}
+	int32* Index = HitBoxIndex.Find(name);
+	return Index ? &MOBA_HitBoxMap[*Index] : nullptr;
+}
+
+int32 AMHUD::FindHitBoxAt(FVector2D pos)
+{
+	if (HitBoxLookupDirty)
 	{
-		if(MOBA_HitBoxMap[Index].GetName() == name)
+		RebuildHitBoxLookup();
+	}
+	if (HitBoxCols == 0)
+	{
+		return INDEX_NONE;
+	}
+	// 格子外的點夾到邊上的格子 最後還是用Contains判斷
+	const int32 X = FMath::Clamp(FMath::FloorToInt((pos.X / ViewportScale - HitBoxGridOrigin.X) / HitBoxCellSize.X), 0, HitBoxCols - 1);
+	const int32 Y = FMath::Clamp(FMath::FloorToInt((pos.Y / ViewportScale - HitBoxGridOrigin.Y) / HitBoxCellSize.Y), 0, HitBoxRows - 1);
+	const int32 Cell = Y * HitBoxCols + X;
+	// 格子裡照MOBA_HitBoxMap的順序 先找到的優先權高
+	for (int32 i = HitBoxCellStart[Cell]; i < HitBoxCellStart[Cell + 1]; ++i)
+	{
+		if (MOBA_HitBoxMap[HitBoxCellItems[i]].Contains(pos, ViewportScale))
 		{
-			return &MOBA_HitBoxMap[Index];
+			return HitBoxCellItems[i];
 		}
 	}
-	return nullptr;
+	return INDEX_NONE;
 }
 
-void AMHUD::MOBA_AddHitBox(FVector2D Position, FVector2D Size, const FString& Name,
-	int32 Priority, bool bConsumesInput)
+void AMHUD::RebuildHitBoxLookup()
 {
-	bool bAdded = false;
-	for(int32 Index = 0; Index < MOBA_HitBoxMap.Num(); ++Index)
+	HitBoxLookupDirty = false;
+	HitBoxIndex.Reset();
+	HitBoxCellStart.Reset();
+	HitBoxCellItems.Reset();
+	HitBoxCols = HitBoxRows = 0;
+	if (MOBA_HitBoxMap.Num() == 0)
 	{
-		if(MOBA_HitBoxMap[Index].GetPriority() < Priority)
+		return;
+	}
+	FVector2D Min(MAX_FLT, MAX_FLT), Max(-MAX_FLT, -MAX_FLT);
+	for (int32 Index = 0; Index < MOBA_HitBoxMap.Num(); ++Index)
+	{
+		const FMHitBox& HitBox = MOBA_HitBoxMap[Index];
+		// 同名取第一個
+		if (!HitBoxIndex.Contains(HitBox.GetName()))
 		{
-			MOBA_HitBoxMap.Insert(FMHitBox(Position, Size, Name, bConsumesInput, Priority), Index);
-			bAdded = true;
-			break;
+			HitBoxIndex.Add(HitBox.GetName(), Index);
+		}
+		Min = FVector2D::Min(Min, HitBox.Coords);
+		Max = FVector2D::Max(Max, HitBox.Coords + HitBox.Size);
+	}
+	const float CellSize = 32;
+	HitBoxGridOrigin = Min;
+	HitBoxCols = FMath::Clamp(FMath::FloorToInt((Max.X - Min.X) / CellSize) + 1, 1, 256);
+	HitBoxRows = FMath::Clamp(FMath::FloorToInt((Max.Y - Min.Y) / CellSize) + 1, 1, 256);
+	// 區域太大時格子放大 最多256x256格
+	HitBoxCellSize.X = FMath::Max(CellSize, (Max.X - Min.X) / HitBoxCols);
+	HitBoxCellSize.Y = FMath::Max(CellSize, (Max.Y - Min.Y) / HitBoxRows);
+	HitBoxCellStart.AddZeroed(HitBoxCols * HitBoxRows + 1);
+	TArray<int32> Fill;
+	// 先算每格數量再填 縮放誤差所以邊界多算一格
+	for (int32 Pass = 0; Pass < 2; ++Pass)
+	{
+		if (Pass == 1)
+		{
+			for (int32 i = 0; i < HitBoxCols * HitBoxRows; ++i)
+			{
+				HitBoxCellStart[i + 1] += HitBoxCellStart[i];
+			}
+			HitBoxCellItems.SetNumUninitialized(HitBoxCellStart.Last());
+			Fill = HitBoxCellStart;
+		}
+		for (int32 Index = 0; Index < MOBA_HitBoxMap.Num(); ++Index)
+		{
+			const FMHitBox& HitBox = MOBA_HitBoxMap[Index];
+			const FVector2D Lo = HitBox.Coords - Min;
+			const FVector2D Hi = Lo + HitBox.Size;
+			const int32 X0 = FMath::Clamp(FMath::FloorToInt(Lo.X / HitBoxCellSize.X) - 1, 0, HitBoxCols - 1);
+			const int32 X1 = FMath::Clamp(FMath::FloorToInt(Hi.X / HitBoxCellSize.X) + 1, 0, HitBoxCols - 1);
+			const int32 Y0 = FMath::Clamp(FMath::FloorToInt(Lo.Y / HitBoxCellSize.Y) - 1, 0, HitBoxRows - 1);
+			const int32 Y1 = FMath::Clamp(FMath::FloorToInt(Hi.Y / HitBoxCellSize.Y) + 1, 0, HitBoxRows - 1);
+			for (int32 y = Y0; y <= Y1; ++y)
+			{
+				for (int32 x = X0; x <= X1; ++x)
+				{
+					const int32 Cell = y * HitBoxCols + x;
+					if (Pass == 0)
+					{
+						HitBoxCellStart[Cell + 1]++;
+					}
+					else
+					{
+						HitBoxCellItems[Fill[Cell]++] = Index;
+					}
+				}
+			}
 		}
 	}
-	if(!bAdded)
+}
+
+void AMHUD::InsertHitBox(const FMHitBox& HitBox)
+{
+	for(int32 Index = 0; Index < MOBA_HitBoxMap.Num(); ++Index)
 	{
-		MOBA_HitBoxMap.Add(FMHitBox(Position, Size, Name, bConsumesInput, Priority));
+		if(MOBA_HitBoxMap[Index].GetPriority() < HitBox.GetPriority())
+		{
+			MOBA_HitBoxMap.Insert(HitBox, Index);
+			return;
+		}
 	}
+	MOBA_HitBoxMap.Add(HitBox);
 }
 
-void AMHUD::MOBA_CleanHitBox()
+void AMHUD::MOBA_AddHitBox(FVector2D Position, FVector2D Size, const FString& Name,
+	int32 Priority, bool bConsumesInput)
 {
-	MOBA_HitBoxMap.Empty();
+	const FMHitBox HitBox(Position, Size, Name, bConsumesInput, Priority);
+	BlueprintHitBoxes.Add(HitBox);
+	InsertHitBox(HitBox);
+	HitBoxLookupDirty = true;
 }
 
-bool AMHUD::IsGameRegion(FVector2D pos)
+void AMHUD::MOBA_CleanHitBox()
 {
-	for(FMHitBox& HitBox : MOBA_HitBoxMap)
+	// 沒有藍圖的hitbox時不用重建格子
+	if (BlueprintHitBoxes.Num() > 0)
 	{
-		if(HitBox.Contains(pos, ViewportScale))
-		{
-			return false;
-		}
+		BlueprintHitBoxes.Reset();
+		RebuildHitBoxMap();
 	}
-	return true;
+}
+
+bool AMHUD::IsGameRegion(FVector2D pos)
+{
+	return FindHitBoxAt(pos) == INDEX_NONE;
 }
 
 bool AMHUD::IsUIRegion(FVector2D pos)
@@ -791,7 +1182,7 @@ void AMHUD::OnLMousePressed2(FVector2D pos)
 				else if (hs->SkillBehavior[HEROB::UnitTarget])
 				{
 					if ((CurrentSelectTarget->TeamId != hero->TeamId && 
-						!CurrentSelectTarget->BuffStateMap[HEROS::BanBeSkillSight]) ||
+						!CurrentSelectTarget->HasBuffState(HEROS::BanBeSkillSight)) ||
 						(CurrentSelectTarget->TeamId == hero->TeamId && 
 						hs->SkillBehavior[HEROB((int)HEROB::UnitTarget_HeroUnit + (int)CurrentSelectTarget->UnitType)]))
 					{
@@ -813,7 +1204,7 @@ void AMHUD::OnLMousePressed2(FVector2D pos)
 				else if (hs->SkillBehavior[HEROB::UnitTargetEnemy] &&
 					IsValid(CurrentSelectTarget) && CurrentSelectTarget->TeamId != hero->TeamId)
 				{
-					if (!CurrentSelectTarget->BuffStateMap[HEROS::BanBeSkillSight] &&
+					if (!CurrentSelectTarget->HasBuffState(HEROS::BanBeSkillSight) &&
 						hs->SkillBehavior[HEROB((int)HEROB::UnitTarget_HeroUnit + (int)CurrentSelectTarget->UnitType)])
 					{
 						act.ActionStatus = EHeroActionStatus::SpellToActor;
@@ -3,7 +3,10 @@
 #pragma once
 
 #include "GameFramework/HUD.h"
+#include "CanvasItem.h"
 #include "MHitBox.h"
+#include "HUDSnapshot.h"
+#include "DamageNumberRenderer.h"
 #include "MHUD.generated.h"
 
 
@@ -52,11 +55,62 @@ struct FMousePointer
 
 };
 
+// 網頁UI的一個區域 座標是網頁的pixel
+USTRUCT(BlueprintType)
+struct FUIRegion
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Id;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector2D Position = FVector2D::ZeroVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector2D Size = FVector2D::ZeroVector;
+};
+
+
+// HUD每個Frame投影一次的單位螢幕座標
+struct FUnitScreenInfo
+{
+	ABasicUnit* Unit;
+	// 單位中心
+	FVector2D Center;
+	// 頭上 畫血條用 死掉的單位不投影
+	FVector2D Head;
+	// 腳下 畫名字用
+	FVector2D Foot;
+};
+
+// ScreenUnits的螢幕格子 點選跟框選只看附近的格子
+struct FScreenGrid
+{
+	float CellSize = 64;
+	int32 Cols = 0;
+	int32 Rows = 0;
+	// 每格在Items的起點 長度Cols*Rows+1
+	TArray<int32> CellStart;
+	// ScreenUnits的index 依格子排好
+	TArray<int32> Items;
+
+	void Build(const TArray<FUnitScreenInfo>& Units, float Width, float Height);
+	// 找離Pos最近且距離小於MaxDistance的單位 沒有回傳INDEX_NONE
+	int32 FindNearest(const TArray<FUnitScreenInfo>& Units, const FVector2D& Pos, float MaxDistance) const;
+	// 跟矩形重疊的格子裡的單位 還要自己再檢查座標
+	void QueryRect(const FVector2D& Min, const FVector2D& Max, TArray<int32>& Out) const;
+
+private:
+	int32 CellX(float X) const { return FMath::Clamp(FMath::FloorToInt(X / CellSize), 0, Cols - 1); }
+	int32 CellY(float Y) const { return FMath::Clamp(FMath::FloorToInt(Y / CellSize), 0, Rows - 1); }
+};
 
 class AMOBAPlayerController;
 class AHeroCharacter;
 class AEquipment;
 class ASceneObject;
+class UWebInterface;
 /**
  * 
  */
@@ -77,6 +131,19 @@ public:
 
 	bool CheckInSelectionBox(FVector2D pos);
 
+	// 剔除畫面外的單位 投影一次存到ScreenUnits 點選框選血條都用這份
+	void UpdateScreenUnits();
+
+	// 框選只對進出框的單位開關選取
+	void UpdateBoxSelection();
+
+	// 血條魔條先放進同一批三角形 最後一次畫完
+	void AddBarRect(const FLinearColor& Color, float X, float Y, float W, float H);
+	void FlushBars();
+
+	// 飄字 由HUD統一畫 不生成ADamageEffect
+	void AddDamageNumber(const ADamageEffect* Style, const FVector& pos, const FVector& dir, int32 Damage);
+
 	UFUNCTION(BlueprintCallable, Category = "MOBA")
 	void ClearAllSelection();
 
@@ -84,6 +151,21 @@ public:
 
 	FMHitBox* FindHitBoxByName(const FString& name);
 
+	// 回傳第一個包含pos的hitbox 沒有回傳INDEX_NONE
+	int32 FindHitBoxAt(FVector2D pos);
+
+	// 名字表跟格子 hitbox改變後第一次查詢時重建
+	void RebuildHitBoxLookup();
+
+	// 用目前的ViewportScale把UIRegions轉成hitbox
+	void ApplyUIRegions();
+
+	// 依優先權插入MOBA_HitBoxMap 同優先權的排在後面
+	void InsertHitBox(const FMHitBox& HitBox);
+
+	// MOBA_HitBoxMap = UI區域的hitbox + 藍圖這個Frame加的hitbox
+	void RebuildHitBoxMap();
+
 	UFUNCTION(BlueprintImplementableEvent, Category = "MOBA")
 	void MOBA_HitBoxRButtonPressed(const FString& name);
 
@@ -99,9 +181,17 @@ public:
 	UFUNCTION(BlueprintImplementableEvent, Category = "MOBA")
 	void MOBA_MouseRButtonPressed();
 
+	// 沒有設定WebUI時每個Frame呼叫 由藍圖自己組json
 	UFUNCTION(BlueprintImplementableEvent, Category = "MOBA")
 	void UpdateHeroData(ABasicUnit* hero);
 
+	// 設定後選取單位的狀態改由C++直接推給網頁 不再呼叫UpdateHeroData
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void SetWebInterface(UWebInterface* wi);
+
+	// 把選取單位的狀態推給網頁 數值有變才送
+	void PushHeroSnapshot(ABasicUnit* hero);
+
 	UFUNCTION(BlueprintImplementableEvent, Category = "MOBA")
 	void FocusUnit(UWebInterfaceJsonValue* hero);
 
@@ -113,7 +203,7 @@ public:
 	void MOBA_AddHitBox(FVector2D Position, FVector2D Size, const FString& Name, 
 		int32 Priority, bool bConsumesInput);
 
-	// 加入一個可以被點選的按鈕
+	// 清掉藍圖加的按鈕 每個Frame都會清 UI區域的hitbox會保留
 	UFUNCTION(BlueprintCallable, Category = "MOBA")
 	void MOBA_CleanHitBox();
 
@@ -138,9 +228,26 @@ public:
 	]
 	}
 	*/
+	// 網頁還沒推過UpdateUIRegion前 每個Frame呼叫 字串沒變就不解析
 	UFUNCTION(BlueprintImplementableEvent, Category = "MOBA")
 	FString GetUIRegion();
 
+	// UI版面改變時設定 會重建hitbox
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void SetUIRegions(const TArray<FUIRegion>& Regions);
+
+	// 格式同GetUIRegion 跟上次一樣的字串直接略過
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void SetUIRegionJson(const FString& JsonString);
+
+	// 網頁的ue.interface.broadcast
+	UFUNCTION()
+	void OnWebInterfaceEvent(const FName Name, UWebInterfaceJsonValue* Data);
+
+	// 每次UI區域改變加一
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "MOBA")
+	int32 UIRegionVersion = 0;
+
 	UFUNCTION(BlueprintCallable, Category = "MOBA")
 	bool IsGameRegion(FVector2D pos);
 
@@ -257,6 +364,10 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA")
 	FVector2D	HPBarOffset;
 
+	// 視錐剔除用的單位半徑 要包含頭上的血條
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA")
+	float ScreenCullRadius = 300;
+
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "MOBA")
 	uint32 ClickedSelected:1;
 
@@ -347,4 +458,66 @@ public:
 	float ViewportScale;
 
 	int32 SequenceNumber;
+
+	// 推送選取單位狀態的網頁
+	UPROPERTY()
+	UWebInterface* WebUI = nullptr;
+
+	// 這次跟上次送出的狀態
+	FUnitHUDSnapshot HeroSnapshot;
+	FUnitHUDSnapshot LastHeroSnapshot;
+	FUnitHUDText HeroText;
+	FUnitHUDText LastHeroText;
+
+	// 上次送出的單位
+	ABasicUnit* LastSnapshotUnit = nullptr;
+
+	// 重複使用的javascript字串
+	FString SnapshotScript;
+
+	// 這個Frame所有血條的三角形
+	TArray<FCanvasUVTri> BarTriangles;
+
+	// 所有飄字
+	FDamageNumberRenderer DamageNumbers;
+
+	// 畫面內的單位
+	TArray<FUnitScreenInfo> ScreenUnits;
+
+	// 每次UpdateScreenUnits加一
+	uint32 ScreenStamp = 0;
+
+	// ScreenUnits的格子
+	FScreenGrid ScreenGrid;
+
+	// 目前在框裡的單位 下一個Frame跟新的框比對 用TSet查離開框的單位
+	UPROPERTY()
+	TSet<ABasicUnit*> BoxSelection;
+	UPROPERTY()
+	TSet<ABasicUnit*> NextBoxSelection;
+	TArray<int32> BoxQuery;
+	bool BoxSelecting = false;
+
+	// 最後一次設定的UI區域
+	TArray<FUIRegion> UIRegions;
+	FString LastUIRegionJson;
+	// 轉成hitbox時的ViewportScale 改變要重建
+	float UIRegionScale = 0;
+	// 網頁有推過區域就不再每個Frame問藍圖
+	bool UIRegionPushed = false;
+	// UIRegions轉好的hitbox 區域或縮放改變才重建
+	TArray<FMHitBox> UIRegionHitBoxes;
+	// 藍圖用MOBA_AddHitBox加的hitbox
+	TArray<FMHitBox> BlueprintHitBoxes;
+
+	// hitbox名字對應MOBA_HitBoxMap的index
+	TMap<FString, int32> HitBoxIndex;
+	// hitbox的格子 座標跟FMHitBox::Coords一樣
+	FVector2D HitBoxGridOrigin = FVector2D::ZeroVector;
+	FVector2D HitBoxCellSize = FVector2D(32, 32);
+	int32 HitBoxCols = 0;
+	int32 HitBoxRows = 0;
+	TArray<int32> HitBoxCellStart;
+	TArray<int32> HitBoxCellItems;
+	bool HitBoxLookupDirty = true;
 };
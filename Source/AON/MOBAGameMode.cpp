@@ -27,7 +27,6 @@ void AMOBAGameMode::ServerSetHeroAction_Implementation(AHeroCharacter* hero,
 {
 	if (Role == ROLE_Authority && IsValid(hero))
 	{
-		hero->ActionQueue.Empty();
-		hero->ActionQueue.Add(action);
+		hero->SetQueuedAction(action);
 	}
 }
\ No newline at end of file
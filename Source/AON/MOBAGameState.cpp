@@ -4,12 +4,80 @@
 #include "GameFramework/Controller.h"
 #include "GameFramework/Actor.h"
 #include "HeroCharacter.h"
+#include "HeroBuff.h"
+#include "UnrealNetwork.h"
 // for GEngine
 #include "Engine.h"
 #include "AIController.h"
+#include "SingletonManagerActor.h"
+#include "FlannActor.h"
 
 
+AMOBAGameState::AMOBAGameState()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	// 單位在PrePhysics打出來的傷害同一個Frame結算
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+}
+
+void AMOBAGameState::GetLifetimeReplicatedProps(TArray< FLifetimeProperty > & OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AMOBAGameState, RandomSeed);
+}
+
+void AMOBAGameState::BeginPlay()
+{
+	Super::BeginPlay();
+	if (Role == ROLE_Authority && RandomSeed == 0)
+	{
+		RandomSeed = FMath::RandRange(1, MAX_int32);
+	}
+	DamageRandom.Initialize(RandomSeed);
+	// 專用伺服器沒有本地玩家 所以由GameState生成
+	FActorSpawnParameters params;
+	params.Owner = this;
+	SingletonManager = GetWorld()->SpawnActor<ASingletonManagerActor>(params);
+	FlannActor = GetWorld()->SpawnActor<AFlannActor>(params);
+}
+
+void AMOBAGameState::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (IsValid(SingletonManager))
+	{
+		SingletonManager->Destroy();
+	}
+	SingletonManager = nullptr;
+	if (IsValid(FlannActor))
+	{
+		FlannActor->Destroy();
+	}
+	FlannActor = nullptr;
+	Super::EndPlay(EndPlayReason);
+}
+
+void AMOBAGameState::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+	if (Role == ROLE_Authority)
+	{
+		ResolveDamageQueue();
+	}
+}
 
+float AMOBAGameState::GetServerWorldTime(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	if (!World)
+	{
+		return 0;
+	}
+	if (AGameStateBase* GameState = World->GetGameState())
+	{
+		return GameState->GetServerWorldTimeSeconds();
+	}
+	return World->GetTimeSeconds();
+}
 
 float AMOBAGameState::ArmorConvertToInjuryPersent(float armor)
 {
@@ -28,3 +96,246 @@ TArray<int32> AMOBAGameState::GetEXPIncreaseArray()
 	}
 	return res;
 }
+
+void AMOBAGameState::QueueDamage(ABasicUnit* attacker, ABasicUnit* victim, EDamageType dtype, float damage, bool AttackLanded)
+{
+	FQueuedDamage Hit;
+	Hit.Attacker = attacker;
+	Hit.Victim = victim;
+	Hit.DamageType = dtype;
+	Hit.Damage = damage;
+	Hit.AttackLanded = AttackLanded;
+	DamageQueue.Add(Hit);
+}
+
+void AMOBAGameState::ResolveDamageQueue()
+{
+	if (DamageQueue.Num() == 0)
+	{
+		return;
+	}
+	// 結算時藍圖事件打出來的傷害接在後面一起算
+	for (int32 i = 0; i < DamageQueue.Num(); ++i)
+	{
+		const FQueuedDamage Hit = DamageQueue[i];
+		// 前面的傷害可能已經打死了
+		if (!IsValid(Hit.Attacker) || !IsValid(Hit.Victim) || !Hit.Victim->IsAlive)
+		{
+			continue;
+		}
+		// buff有變動過的單位這時才重建表
+		ResolveDamage(Hit, Hit.Attacker->GetDamageTable(), Hit.Victim->GetDamageTable());
+	}
+	DamageQueue.Reset();
+}
+
+void AMOBAGameState::ResolveDamage(const FQueuedDamage& Hit, const FUnitDamageTable& AttackerTable, const FUnitDamageTable& VictimTable)
+{
+	ABasicUnit* attacker = Hit.Attacker;
+	ABasicUnit* victim = Hit.Victim;
+	const EDamageType dtype = Hit.DamageType;
+	const bool AttackLanded = Hit.AttackLanded;
+	const FDamageTypeTable& AttackerType = AttackerTable.Get(dtype);
+	const FDamageTypeTable& VictimType = VictimTable.Get(dtype);
+	float damage = Hit.Damage;
+	// 爆擊跟扣防先計算
+	float Injury = 1;
+	if (dtype == EDamageType::DAMAGE_PHYSICAL)
+	{
+		Injury = ArmorConvertToInjuryPersent(victim->CurrentArmor);
+	}
+	if (AttackerType.Critical.Num() > 0)
+	{
+		damage *= AttackerType.RollCritical(DamageRandom.FRand());
+	}
+
+	float RDamage = damage * Injury; // 扣防後傷害
+	float FDamage = RDamage; // 最終傷害
+	// 是不是靠普攻打出來的傷害
+	if (AttackLanded)
+	{
+		bool attackMiss = false;
+		if (AttackerTable.Miss > 0)
+		{
+			float miss = DamageRandom.FRand();
+			if (AttackerTable.Miss >= miss)
+			{
+				attackMiss = true;
+			}
+		}
+		if (VictimTable.Dodge > 0)
+		{
+			float miss = DamageRandom.FRand();
+			if (VictimTable.Dodge >= miss)
+			{
+				attackMiss = true;
+			}
+		}
+		if (attackMiss)
+		{
+			for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
+			{
+				attacker->Buffs[i]->OnAttackMiss(attacker, victim, dtype, damage, RDamage);
+			}
+			return;
+		}
+	}
+	// 被打的人身上各Buff的格檔
+	for (const FVector2D& Blocking : VictimType.Blocking)
+	{
+		float chance = DamageRandom.FRand();
+		if (Blocking.X >= chance)
+		{
+			FDamage -= Blocking.Y;
+		}
+	}
+	if (VictimType.BlockAll > 0)
+	{
+		float block = DamageRandom.FRand();
+		if (VictimType.BlockAll >= block)
+		{
+			FDamage = 0;
+		}
+	}
+	if (VictimType.BlockConstant != 0)
+	{
+		FDamage -= VictimType.BlockConstant;
+	}
+	if (VictimType.Absorb > 0)
+	{
+		victim->SetCurrentHP(victim->CurrentHP + VictimType.Absorb * RDamage);
+	}
+	FDamage = FDamage * AttackerType.Output * VictimType.Input;
+	if (VictimType.Immune)
+	{
+		FDamage = 0;
+	}
+
+	for (int32 i = 0; i < victim->Buffs.Num(); ++i)
+	{
+		victim->Buffs[i]->BeDamage(attacker, victim, dtype, damage, RDamage);
+	}
+	// 扣掉護盾後的傷害
+	damage = FDamage;
+	switch (dtype)
+	{
+	case EDamageType::DAMAGE_PHYSICAL:
+	{
+		if (victim->CurrentShieldPhysical > 0)
+		{
+			if (victim->CurrentShieldPhysical > FDamage)
+			{
+				damage = 0;
+				victim->SetCurrentShieldPhysical(victim->CurrentShieldPhysical - FDamage);
+			}
+			else if (victim->CurrentShieldPhysical < FDamage)
+			{
+				damage -= victim->CurrentShieldPhysical;
+				victim->SetCurrentShieldPhysical(0);
+			}
+			else
+			{
+				damage = 0;
+				victim->SetCurrentShieldPhysical(0);
+			}
+			if (victim->CurrentShieldPhysical == 0)
+			{
+				for (int32 i = 0; i < victim->Buffs.Num(); ++i)
+				{
+					victim->Buffs[i]->OnShieldPhysicalBreak(attacker, victim);
+				}
+			}
+		}
+	}
+		break;
+	case EDamageType::DAMAGE_MAGICAL:
+	{
+		if (victim->CurrentShieldMagical > 0)
+		{
+			if (victim->CurrentShieldMagical > FDamage)
+			{
+				damage = 0;
+				victim->SetCurrentShieldMagical(victim->CurrentShieldMagical - FDamage);
+			}
+			else if (victim->CurrentShieldMagical < FDamage)
+			{
+				damage -= victim->CurrentShieldMagical;
+				victim->SetCurrentShieldMagical(0);
+			}
+			else
+			{
+				damage = 0;
+				victim->SetCurrentShieldMagical(0);
+			}
+			if (victim->CurrentShieldMagical == 0)
+			{
+				for (int32 i = 0; i < victim->Buffs.Num(); ++i)
+				{
+					victim->Buffs[i]->OnShieldMagicalBreak(attacker, victim);
+				}
+			}
+		}
+	}
+		break;
+	case EDamageType::DAMAGE_PURE:
+		break;
+	default:
+		break;
+	}
+	float damage2 = damage;
+	//通用護盾
+	if (victim->CurrentShield > 0)
+	{
+		if (victim->CurrentShield > damage)
+		{
+			damage2 = 0;
+			victim->SetCurrentShield(victim->CurrentShield - damage);
+		}
+		else if (victim->CurrentShield < damage)
+		{
+			damage2 -= victim->CurrentShield;
+			victim->SetCurrentShield(0);
+		}
+		else
+		{
+			damage2 = 0;
+			victim->SetCurrentShield(0);
+		}
+		if (victim->CurrentShield == 0)
+		{
+			for (int32 i = 0; i < victim->Buffs.Num(); ++i)
+			{
+				victim->Buffs[i]->OnShieldBreak(attacker, victim);
+			}
+		}
+	}
+	victim->SetCurrentHP(victim->CurrentHP - damage2);
+
+	if (AttackerTable.StealHealth > 0)
+	{
+		attacker->SetCurrentHP(attacker->CurrentHP + AttackerTable.StealHealth * FDamage);
+	}
+	if (AttackLanded && IsValid(attacker->CurrentOrb))
+	{
+		attacker->CurrentOrb->OnOrbAttackLanded(attacker, victim, dtype, damage, RDamage);
+	}
+	for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
+	{
+		attacker->Buffs[i]->CreateDamage(attacker, victim, dtype, damage, RDamage);
+		if (AttackLanded)
+		{
+			attacker->Buffs[i]->OnAttackLanded(attacker, victim, dtype, damage, RDamage);
+		}
+	}
+	if (AttackLanded)
+	{
+		attacker->ServerPlayAttackLandedSFX();
+	}
+	for (int32 i = 0; i < victim->Buffs.Num(); ++i)
+	{
+		victim->Buffs[i]->BeDamage(attacker, victim, dtype, damage, RDamage);
+	}
+	// 顯示傷害文字
+	attacker->ServerShowDamageEffect(victim->GetActorLocation(),
+		victim->GetActorLocation() - attacker->GetActorLocation(), FDamage);
+}
@@ -3,8 +3,36 @@
 #pragma once
 
 #include "GameFramework/GameState.h"
+#include "MobaEnum.h"
+#include "DamageTable.h"
 #include "MOBAGameState.generated.h"
 
+class ABasicUnit;
+class ASingletonManagerActor;
+class AFlannActor;
+
+// 等待結算的一次傷害
+USTRUCT()
+struct FQueuedDamage
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	ABasicUnit* Attacker = nullptr;
+
+	UPROPERTY()
+	ABasicUnit* Victim = nullptr;
+
+	UPROPERTY()
+	EDamageType DamageType = EDamageType::DAMAGE_PHYSICAL;
+
+	UPROPERTY()
+	float Damage = 0;
+
+	UPROPERTY()
+	bool AttackLanded = false;
+};
+
 /**
  * 有需要全地圖大招可以改這裡的參數
  * if any hero need big spell, you can modify this parameter
@@ -14,6 +42,14 @@ class AON_API AMOBAGameState : public AGameStateBase
 {
 	GENERATED_BODY()
 public:
+	AMOBAGameState();
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Tick(float DeltaSeconds) override;
+
 	// IncreaseMap
 	TArray<int32> GetEXPIncreaseArray();
 
@@ -55,5 +91,37 @@ public:
 	// 敵人死亡後吸收經驗值的範圍
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MOBA")
 	int32 EXPGetRange;
-		
+
+	// 整場比賽的亂數種子 0的話開場時隨機產生
+	// 同樣的種子跟同樣順序的傷害會算出一樣的結果 可以重播驗證
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Replicated, Category = "MOBA")
+	int32 RandomSeed = 0;
+
+	// 排入傷害 在這個Frame的Tick一起結算
+	void QueueDamage(ABasicUnit* attacker, ABasicUnit* victim, EDamageType dtype, float damage, bool AttackLanded);
+
+	// 依排入順序結算所有傷害
+	void ResolveDamageQueue();
+
+	// 伺服器的世界時間 客戶端是GameState同步過的值 還沒有GameState時用自己的
+	// 同步計時用的時間戳都以這個為準
+	static float GetServerWorldTime(const UObject* WorldContextObject);
+
+	// 統一更新所有單位的管理者 每個World各自生成一個 不同步
+	UPROPERTY()
+	ASingletonManagerActor* SingletonManager = nullptr;
+
+	// 這個World唯一的空間索引 所有玩家跟單位共用 用AFlannActor::Get取得
+	UPROPERTY()
+	AFlannActor* FlannActor = nullptr;
+
+private:
+	// 結算一次傷害
+	void ResolveDamage(const FQueuedDamage& Hit, const FUnitDamageTable& AttackerTable, const FUnitDamageTable& VictimTable);
+
+	// 傷害結算用的亂數
+	FRandomStream DamageRandom;
+
+	UPROPERTY()
+	TArray<FQueuedDamage> DamageQueue;
 };
@@ -27,14 +27,6 @@ AMOBAPlayerController::AMOBAPlayerController()
 
 void AMOBAPlayerController::BeginPlay()
 {
-
-	FlannActor = GetWorld()->SpawnActor<AFlannActor>();
-	if (FlannActor == nullptr)
-	{
-		GEngine->AddOnScreenDebugMessage(-1, 0.1f, FColor::Cyan,
-			FString::Printf(TEXT("FlannActor is Null")));
-	}
-	
 	bMouseLButton = false;
 	bShowMouseCursor = false;
 }
@@ -377,8 +369,7 @@ void AMOBAPlayerController::ServerSetHeroAction_Implementation(ABasicUnit* hero,
 {
 	if (Role == ROLE_Authority && IsValid(hero))
 	{
-		hero->ActionQueue.Empty();
-		hero->ActionQueue.Add(action);
+		hero->SetQueuedAction(action);
 	}
 }
 
@@ -392,7 +383,12 @@ void AMOBAPlayerController::ServerAppendHeroAction_Implementation(ABasicUnit* he
 {
 	if (Role == ROLE_Authority)
 	{
-		hero->ActionQueue.Add(action);
+		// 駐列滿了就推掉最舊的動作 最新的插旗一定要收
+		if (!hero->AppendQueuedAction(action))
+		{
+			hero->PopAction();
+			hero->AppendQueuedAction(action);
+		}
 	}
 }
 
@@ -406,7 +402,7 @@ void AMOBAPlayerController::ServerClearHeroAction_Implementation(ABasicUnit* her
 {
 	if (Role == ROLE_Authority)
 	{
-		hero->ActionQueue.Empty();
+		hero->ClearQueuedActions();
 	}
 }
 
@@ -474,7 +470,7 @@ void AMOBAPlayerController::ServerHeroSkillLevelUp_Implementation(AHeroCharacter
 	{
 		if (hero->Skills.Num() > idx && idx >= 0 && hero->CurrentSkillPoints > 0)
 		{
-			hero->CurrentSkillPoints--;
+			hero->SetCurrentSkillPoints(hero->CurrentSkillPoints - 1);
 			hero->Skills[idx]->LevelUp();
 		}
 	}
@@ -524,7 +520,7 @@ void AMOBAPlayerController::ServerHealCompute_Implementation(ABasicUnit* attacke
 		{
 			attacker->Buffs[i]->OnHealLanded(attacker, victim, amount);
 		}
-		victim->CurrentHP += amount * victim->BuffPropertyMap[HEROP::HealPercentage];
+		victim->SetCurrentHP(victim->CurrentHP + amount * victim->GetBuffProperty(HEROP::HealPercentage));
 	}
 }
 
@@ -535,350 +531,17 @@ bool AMOBAPlayerController::ServerAttackCompute_Validate(ABasicUnit* attacker, A
 
 void AMOBAPlayerController::ServerAttackCompute_Implementation(ABasicUnit* attacker, ABasicUnit* victim, EDamageType dtype, float damage, bool AttackLanded)
 {
-	if (Role == ROLE_Authority && IsValid(attacker) && IsValid(victim) && victim->IsAlive)
+	AMOBAGameState* ags = Cast<AMOBAGameState>(UGameplayStatics::GetGameState(GetWorld()));
+	if (Role == ROLE_Authority && IsValid(ags) && IsValid(attacker) && IsValid(victim) && victim->IsAlive)
 	{
-		AMOBAGameState* ags = Cast<AMOBAGameState>(UGameplayStatics::GetGameState(GetWorld()));
-		float Injury = 1;
-		// 爆擊跟扣防先計算
-		float max_critical = 1;
-		switch (dtype)
-		{
-		case EDamageType::DAMAGE_PHYSICAL:
-			Injury = ags->ArmorConvertToInjuryPersent(victim->CurrentArmor);
-			for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
-			{
-				if (attacker->Buffs[i]->BuffUniqueMap.Contains(HEROU::PhysicalCriticalChance))
-				{
-					float chance = FMath::FRandRange(0, 1);
-					if (attacker->Buffs[i]->BuffUniqueMap[HEROU::PhysicalCriticalChance] >= chance &&
-						attacker->Buffs[i]->BuffUniqueMap[HEROU::PhysicalCriticalPercentage] >= max_critical)
-					{
-						max_critical = attacker->Buffs[i]->BuffUniqueMap[HEROU::PhysicalCriticalPercentage];
-					}
-				}
-			}
-			break;
-		case EDamageType::DAMAGE_MAGICAL:
-			for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
-			{
-				if (attacker->Buffs[i]->BuffUniqueMap.Contains(HEROU::MagicalCriticalChance))
-				{
-					float chance = FMath::FRandRange(0, 1);
-					if (attacker->Buffs[i]->BuffUniqueMap[HEROU::MagicalCriticalChance] >= chance &&
-						attacker->Buffs[i]->BuffUniqueMap[HEROU::MagicalCriticalPercentage] >= max_critical)
-					{
-						max_critical = attacker->Buffs[i]->BuffUniqueMap[HEROU::MagicalCriticalPercentage];
-					}
-				}
-			}
-			break;
-		case EDamageType::DAMAGE_PURE:
-			for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
-			{
-				if (attacker->Buffs[i]->BuffUniqueMap.Contains(HEROU::PureCriticalChance))
-				{
-					float chance = FMath::FRandRange(0, 1);
-					if (attacker->Buffs[i]->BuffUniqueMap[HEROU::PureCriticalChance] >= chance &&
-						attacker->Buffs[i]->BuffUniqueMap[HEROU::PureCriticalPercentage] >= max_critical)
-					{
-						max_critical = attacker->Buffs[i]->BuffUniqueMap[HEROU::PureCriticalPercentage];
-					}
-				}
-			}
-			break;
-		default:
-			break;
-		}
-		damage *= max_critical;
-
-		float RDamage = damage * Injury; // 扣防後傷害
-		float FDamage = RDamage; // 最終傷害
-								 // 是不是靠普攻打出來的傷害
-		if (AttackLanded)
-		{
-			bool attackMiss = false;
-			// Buff Property Compute
-			if (attacker->BuffPropertyMap[HEROP::AttackMiss] > 0)
-			{
-				float miss = FMath::FRandRange(0, 1);
-				if (attacker->BuffPropertyMap[HEROP::AttackMiss] >= miss)
-				{
-					attackMiss = true;
-				}
-			}
-			if (victim->BuffPropertyMap[HEROP::Dodge] > 0)
-			{
-				float miss = FMath::FRandRange(0, 1);
-				if (victim->BuffPropertyMap[HEROP::Dodge] >= miss)
-				{
-					attackMiss = true;
-				}
-			}
-			if (attackMiss)
-			{
-				for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
-				{
-					attacker->Buffs[i]->OnAttackMiss(attacker, victim, dtype, damage, RDamage);
-				}
-				return;
-			}
-		}
-		
-		for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
-		{
-			for (auto& Elem : attacker->Buffs[i]->BuffUniqueMap)
-			{
-				if (Elem.Key == HEROU::BlockingPhysicalChance && dtype == EDamageType::DAMAGE_PHYSICAL)
-				{
-					float chance = FMath::FRandRange(0, 1);
-					if (Elem.Value >= max_critical)
-					{
-						FDamage -= victim->Buffs[i]->BuffUniqueMap[HEROU::BlockingPhysicalConstant];
-					}
-				}
-				else if (Elem.Key == HEROU::BlockingMagicalChance && dtype == EDamageType::DAMAGE_MAGICAL)
-				{
-					float chance = FMath::FRandRange(0, 1);
-					if (Elem.Value >= max_critical)
-					{
-						FDamage -= victim->Buffs[i]->BuffUniqueMap[HEROU::BlockingMagicalConstant];
-					}
-				}
-				else if (Elem.Key == HEROU::BlockingPureChance && dtype == EDamageType::DAMAGE_PURE)
-				{
-					float chance = FMath::FRandRange(0, 1);
-					if (Elem.Value >= max_critical)
-					{
-						FDamage -= victim->Buffs[i]->BuffUniqueMap[HEROU::BlockingPureConstant];
-					}
-				}
-			}
-		}
-
-		if (dtype == EDamageType::DAMAGE_PHYSICAL)
-		{
-			if (victim->BuffPropertyMap[HEROP::BlockingPhysical] > 0)
-			{
-				float block = FMath::FRandRange(0, 1);
-				if (victim->BuffPropertyMap[HEROP::BlockingPhysical] >= block)
-				{
-					FDamage = 0;
-				}
-			}
-			if (victim->BuffPropertyMap[HEROP::BlockingPhysicalConstant] != 0)
-			{
-				FDamage -= victim->BuffPropertyMap[HEROP::BlockingPhysicalConstant];
-			}
-			if (victim->BuffPropertyMap[HEROP::AbsorbPhysicalDamagePercentage] > 0)
-			{
-				victim->CurrentHP += victim->BuffPropertyMap[HEROP::AbsorbPhysicalDamagePercentage] * RDamage;
-			}
-			FDamage = FDamage * attacker->BuffPropertyMap[HEROP::PhysicalDamageOutputPercentage]
-				* victim->BuffPropertyMap[HEROP::PhysicalDamageInputPercentage];
-
-			if (victim->BuffStateMap[HEROS::PhysicalImmune])
-			{
-				FDamage = 0;
-			}
-		}
-		else if (dtype == EDamageType::DAMAGE_MAGICAL)
-		{
-			if (victim->BuffPropertyMap[HEROP::BlockingMagical] > 0)
-			{
-				float block = FMath::FRandRange(0, 1);
-				if (victim->BuffPropertyMap[HEROP::BlockingMagical] >= block)
-				{
-					FDamage = 0;
-				}
-			}
-			if (victim->BuffPropertyMap[HEROP::BlockingMagicalConstant] != 0)
-			{
-				FDamage -= victim->BuffPropertyMap[HEROP::BlockingMagicalConstant];
-			}
-			if (victim->BuffPropertyMap[HEROP::AbsorbMagicalDamagePercentage] > 0)
-			{
-				victim->CurrentHP += victim->BuffPropertyMap[HEROP::AbsorbMagicalDamagePercentage] * RDamage;
-			}
-			FDamage = FDamage * attacker->BuffPropertyMap[HEROP::MagicalDamageOutputPercentage]
-				* victim->BuffPropertyMap[HEROP::MagicalDamageInputPercentage];
-
-			if (victim->BuffStateMap[HEROS::MagicalImmune])
-			{
-				FDamage = 0;
-			}
-		}
-		else if (dtype == EDamageType::DAMAGE_PURE)
-		{
-			if (victim->BuffPropertyMap[HEROP::BlockingPure] > 0)
-			{
-				float block = FMath::FRandRange(0, 1);
-				if (victim->BuffPropertyMap[HEROP::BlockingPure] >= block)
-				{
-					FDamage = 0;
-				}
-			}
-			if (victim->BuffPropertyMap[HEROP::BlockingPureConstant] != 0)
-			{
-				FDamage -= victim->BuffPropertyMap[HEROP::BlockingPureConstant];
-			}
-			if (victim->BuffPropertyMap[HEROP::AbsorbPureDamagePercentage] > 0)
-			{
-				victim->CurrentHP += victim->BuffPropertyMap[HEROP::AbsorbPureDamagePercentage] * RDamage;
-			}
-			FDamage = FDamage * attacker->BuffPropertyMap[HEROP::PureDamageOutputPercentage]
-				* victim->BuffPropertyMap[HEROP::PureDamageInputPercentage];
-
-			if (victim->BuffStateMap[HEROS::PureImmune])
-			{
-				FDamage = 0;
-			}
-		}
-
-		//GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Cyan,
-		//FString::Printf(TEXT("Server FDamage %f"), FDamage));
-
-		for (int32 i = 0; i < victim->Buffs.Num(); ++i)
-		{
-			victim->Buffs[i]->BeDamage(attacker, victim, dtype, damage, RDamage);
-		}
-		float damage = FDamage;
-		switch (dtype)
-		{
-		case EDamageType::DAMAGE_PHYSICAL:
-		{
-			if (victim->CurrentShieldPhysical > 0)
-			{
-				if (victim->CurrentShieldPhysical > FDamage)
-				{
-					damage = 0;
-					victim->CurrentShieldPhysical -= FDamage;
-				}
-				else if (victim->CurrentShieldPhysical < FDamage)
-				{
-					damage -= victim->CurrentShieldPhysical;
-					victim->CurrentShieldPhysical = 0;
-				}
-				else
-				{
-					damage = 0;
-					victim->CurrentShieldPhysical = 0;
-				}
-				if (victim->CurrentShieldPhysical == 0)
-				{
-					for (int32 i = 0; i < victim->Buffs.Num(); ++i)
-					{
-						victim->Buffs[i]->OnShieldPhysicalBreak(attacker, victim);
-					}
-				}
-			}
-		}
-			break;
-		case EDamageType::DAMAGE_MAGICAL:
-		{
-			if (victim->CurrentShieldMagical > 0)
-			{
-				if (victim->CurrentShieldMagical > FDamage)
-				{
-					damage = 0;
-					victim->CurrentShieldMagical -= FDamage;
-				}
-				else if (victim->CurrentShieldMagical < FDamage)
-				{
-					damage -= victim->CurrentShieldMagical;
-					victim->CurrentShieldMagical = 0;
-				}
-				else
-				{
-					damage = 0;
-					victim->CurrentShieldMagical = 0;
-				}
-				if (victim->CurrentShieldMagical == 0)
-				{
-					for (int32 i = 0; i < victim->Buffs.Num(); ++i)
-					{
-						victim->Buffs[i]->OnShieldMagicalBreak(attacker, victim);
-					}
-				}
-			}
-		}
-			break;
-		case EDamageType::DAMAGE_PURE:
-			break;
-		default:
-			break;
-		}
-		float damage2 = damage;
-		//通用護盾
-		if (victim->CurrentShield > 0)
-		{
-			if (victim->CurrentShield > damage)
-			{
-				damage2 = 0;
-				victim->CurrentShield -= damage;
-			}
-			else if (victim->CurrentShield < damage)
-			{
-				damage2 -= victim->CurrentShield;
-				victim->CurrentShield = 0;
-			}
-			else
-			{
-				damage2 = 0;
-				victim->CurrentShield = 0;
-			}
-			if (victim->CurrentShield == 0)
-			{
-				for (int32 i = 0; i < victim->Buffs.Num(); ++i)
-				{
-					victim->Buffs[i]->OnShieldBreak(attacker, victim);
-				}
-			}
-		}
-		victim->CurrentHP -= damage2;
-
-		if (attacker->BuffPropertyMap[HEROP::StealHealth] > 0)
-		{
-			attacker->CurrentHP += attacker->BuffPropertyMap[HEROP::StealHealth] * FDamage;
-		}
-		if (AttackLanded && IsValid(attacker->CurrentOrb))
-		{
-			attacker->CurrentOrb->OnOrbAttackLanded(attacker, victim, dtype, damage, RDamage);
-		}
-		for (int32 i = 0; i < attacker->Buffs.Num(); ++i)
-		{
-			attacker->Buffs[i]->CreateDamage(attacker, victim, dtype, damage, RDamage);
-			if (AttackLanded)
-			{
-				attacker->Buffs[i]->OnAttackLanded(attacker, victim, dtype, damage, RDamage);
-			}
-		}
-		if (AttackLanded)
-		{
-			attacker->ServerPlayAttackLandedSFX();
-		}
-		for (int32 i = 0; i < victim->Buffs.Num(); ++i)
-		{
-			victim->Buffs[i]->BeDamage(attacker, victim, dtype, damage, RDamage);
-		}
-		// 顯示傷害文字
-		attacker->ServerShowDamageEffect(victim->GetActorLocation(),
-			victim->GetActorLocation() - attacker->GetActorLocation(), FDamage);
+		// 排到這個Frame一起結算
+		ags->QueueDamage(attacker, victim, dtype, damage, AttackLanded);
 	}
 	else
 	{
 		GEngine->AddOnScreenDebugMessage(-1, 0.1f, FColor::Cyan,
 			FString::Printf(TEXT("attacker or victim error")));
 	}
-	/*
-	if (victim->BuffPropertyMap[HEROP::MinHealth] > 0 && victim->CurrentHP < victim->BuffPropertyMap[HEROP::MinHealth])
-	{
-	victim->CurrentHP = victim->BuffPropertyMap[HEROP::MinHealth];
-	}
-	if (victim->BuffPropertyMap[HEROP::MaxHealth] > 0 && victim->CurrentHP > victim->BuffPropertyMap[HEROP::MaxHealth])
-	{
-	victim->CurrentHP = victim->BuffPropertyMap[HEROP::MaxHealth];
-	}
-	*/
 }
 
 bool AMOBAPlayerController::ServerShieldCompute_Validate(ABasicUnit* attacker, ABasicUnit* victim, float amount, EShieldType stype)
@@ -896,7 +559,7 @@ void AMOBAPlayerController::ServerShieldCompute_Implementation(ABasicUnit* caste
 		{
 			victim->Buffs[i]->OnGetShield(caster, victim, amount);
 		}
-		victim->CurrentShield += amount;
+		victim->SetCurrentShield(victim->CurrentShield + amount);
 	}
 		break;
 	case EShieldType::SHIELD_PHYSICAL:
@@ -905,7 +568,7 @@ void AMOBAPlayerController::ServerShieldCompute_Implementation(ABasicUnit* caste
 		{
 			victim->Buffs[i]->OnGetShieldPhysical(caster, victim, amount);
 		}
-		victim->CurrentShieldPhysical += amount;
+		victim->SetCurrentShieldPhysical(victim->CurrentShieldPhysical + amount);
 	}
 		break;
 	case EShieldType::SHIELD_MAGICAL:
@@ -914,7 +577,7 @@ void AMOBAPlayerController::ServerShieldCompute_Implementation(ABasicUnit* caste
 		{
 			victim->Buffs[i]->OnGetShieldMagical(caster, victim, amount);
 		}
-		victim->CurrentShieldMagical += amount;
+		victim->SetCurrentShieldMagical(victim->CurrentShieldMagical + amount);
 	}
 		break;
 	default:
@@ -927,10 +590,10 @@ TArray<ABasicUnit*> AMOBAPlayerController::FindRadiusActorByLocation(ABasicUnit*
 {
 	if (IsValid(hero))
 	{
-		if (FlannActor)
+		// 所有玩家共用GameState的空間索引
+		if (AFlannActor* fa = AFlannActor::Get(this))
 		{
-			std::vector<std::vector<float>> dists;
-			return FlannActor->FindRadiusActorByLocation(hero, Center, Radius, flag, CheckAlive, dists);
+			return fa->FindRadiusActorByLocation(hero, Center, Radius, flag, CheckAlive);
 		}
 	}
 	else
@@ -941,3 +604,27 @@ TArray<ABasicUnit*> AMOBAPlayerController::FindRadiusActorByLocation(ABasicUnit*
 	
 	return TArray<ABasicUnit*>();
 }
+
+void AMOBAPlayerController::FindRadiusActorsBatch(TArray<FRadiusQuery>& Queries, TArray<ABasicUnit*>& Results)
+{
+	if (AFlannActor* fa = AFlannActor::Get(this))
+	{
+		fa->FindRadiusActorsBatch(Queries, Results);
+	}
+	else
+	{
+		Results.Reset();
+	}
+}
+
+TArray<ABasicUnit*> AMOBAPlayerController::FindNearestActorByLocation(ABasicUnit* hero, FVector Center,
+	int32 Count, float MaxRadius, ETeamFlag flag, bool CheckAlive)
+{
+	// 沒有英雄時AFlannActor會回傳空的
+	if (AFlannActor* fa = AFlannActor::Get(this))
+	{
+		return fa->FindNearestActorByLocation(hero, Center, Count, MaxRadius, flag, CheckAlive);
+	}
+
+	return TArray<ABasicUnit*>();
+}
@@ -56,8 +56,6 @@ public:
 	// 有註冊的鍵盤事件
 	TMap<FKey, EKeyBehavior> KeyMapping;
 
-	AFlannActor* FlannActor = nullptr;
-
 	/** Navigate player to the given world location. */	
 	UFUNCTION(Server, WithValidation, Reliable, BlueprintCallable, Category = "MOBA")
 	void ServerCharacterMove(ABasicUnit* hero, const FVector& pos);
@@ -101,6 +99,15 @@ public:
 	TArray<ABasicUnit*> FindRadiusActorByLocation(ABasicUnit* hero, FVector Center,
 		float Radius, ETeamFlag flag, bool CheckAlive);
 
+	// 找最近的Count個單位 最近的在陣列最後
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	TArray<ABasicUnit*> FindNearestActorByLocation(ABasicUnit* hero, FVector Center,
+		int32 Count, float MaxRadius, ETeamFlag flag, bool CheckAlive);
+
+	// 批次範圍查詢 每個Query的ResultStart/ResultNum對應到Results裡的區段
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	void FindRadiusActorsBatch(UPARAM(ref) TArray<FRadiusQuery>& Queries, TArray<ABasicUnit*>& Results);
+
 	FVector2D GetMouseScreenPosition();
 
 	void OnMouseRButtonPressed1();
@@ -0,0 +1,27 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "PooledActor.generated.h"
+
+UINTERFACE(MinimalAPI)
+class UPooledActor : public UInterface
+{
+	GENERATED_BODY()
+};
+
+// 由ASingletonManagerActor::Acquire / Release回收的actor
+// 回收時會藏起來 關掉碰撞跟tick 這裡重設原本BeginPlay / EndPlay會處理的狀態
+class AON_API IPooledActor
+{
+	GENERATED_BODY()
+
+public:
+	// 從回收區拿出來 transform已經設好了
+	virtual void OnPoolAcquired() {}
+
+	// 放回回收區
+	virtual void OnPoolReleased() {}
+};
@@ -7,6 +7,7 @@
 #include "GameFramework/PlayerController.h"
 #include "Components/BoxComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "SingletonManagerActor.h"
 
 // Sets default values
 ASceneObject::ASceneObject(const FObjectInitializer& ObjectInitializer)
@@ -47,6 +48,10 @@ ASceneObject::ASceneObject(const FObjectInitializer& ObjectInitializer)
 void ASceneObject::BeginPlay()
 {
 	Super::BeginPlay();
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->RegisterActor(this);
+	}
 	if (StaticMesh)
 	{
 		StaticMesh->OnClicked.AddDynamic(this, &ASceneObject::OnMouseClicked);
@@ -57,6 +62,15 @@ void ASceneObject::BeginPlay()
 	}
 }
 
+void ASceneObject::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (ASingletonManagerActor* sm = ASingletonManagerActor::Get(this))
+	{
+		sm->UnregisterActor(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void ASceneObject::Tick( float DeltaTime )
 {
@@ -16,6 +16,8 @@ public:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 	
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// Called every frame
 	virtual void Tick( float DeltaSeconds ) override;
 	UPROPERTY(Category = Character, VisibleAnywhere, BlueprintReadOnly)
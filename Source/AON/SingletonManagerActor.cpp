@@ -1,6 +1,17 @@
-// Fill out your copyright notice in the Description page of Project Settings.
+﻿// Fill out your copyright notice in the Description page of Project Settings.
 
 #include "SingletonManagerActor.h"
+#include "EngineUtils.h"
+#include "Engine/Engine.h"
+#include "Async/ParallelFor.h"
+#include "BasicUnit.h"
+#include "HeroBuff.h"
+#include "HeroSkill.h"
+#include "BulletActor.h"
+#include "DamageEffect.h"
+#include "SceneObject.h"
+#include "MOBAGameState.h"
+#include "PooledActor.h"
 
 
 // Sets default values
@@ -8,20 +19,411 @@ ASingletonManagerActor::ASingletonManagerActor()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
-
+	Units.Reserve(1024);
+	UnitDeltaTime.Reserve(1024);
+	DueUnits.Reserve(1024);
+	UnitResults.Reserve(1024);
 }
 
 // Called when the game starts or when spawned
 void ASingletonManagerActor::BeginPlay()
 {
 	Super::BeginPlay();
-	
+	// 管理者生出來之前就BeginPlay的actor
+	// 先收集起來 因為註冊單位時會生回收用的actor
+	TArray<AActor*> existing;
+	for (TActorIterator<AActor> ActorItr(GetWorld()); ActorItr; ++ActorItr)
+	{
+		existing.Add(*ActorItr);
+	}
+	for (AActor* actor : existing)
+	{
+		if (!actor->HasActorBegunPlay() || actor->IsPendingKill())
+		{
+			continue;
+		}
+		if (ABasicUnit* unit = Cast<ABasicUnit>(actor))
+		{
+			RegisterUnit(unit);
+		}
+		else if (AHeroBuff* buff = Cast<AHeroBuff>(actor))
+		{
+			RegisterBuff(buff);
+		}
+		else if (actor->IsA<ABulletActor>() || actor->IsA<ADamageEffect>() || actor->IsA<ASceneObject>())
+		{
+			RegisterActor(actor);
+		}
+	}
+}
+
+void ASingletonManagerActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// 計時還給單位自己 buff的tick還給引擎
+	for (ABasicUnit* unit : Units)
+	{
+		if (IsValid(unit))
+		{
+			unit->SimulationManaged = false;
+			unit->RemoveTickPrerequisiteActor(this);
+		}
+	}
+	for (AHeroBuff* buff : Buffs)
+	{
+		if (IsValid(buff))
+		{
+			buff->SetSimulationManaged(false);
+			buff->SetActorTickEnabled(true);
+		}
+	}
+	for (AActor* actor : Actors)
+	{
+		if (IsValid(actor))
+		{
+			actor->RemoveTickPrerequisiteActor(this);
+		}
+	}
+	Units.Empty();
+	UnitDeltaTime.Empty();
+	DueUnits.Empty();
+	UnitResults.Empty();
+	Buffs.Empty();
+	Actors.Empty();
+	ManagedIndex.Empty();
+	Pools.Empty();
+	Timers.Empty();
+	DueTimers.Empty();
+	Super::EndPlay(EndPlayReason);
+}
+
+ASingletonManagerActor* ASingletonManagerActor::Get(const UObject* WorldContextObject)
+{
+	UWorld* world = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	AMOBAGameState* gs = world ? world->GetGameState<AMOBAGameState>() : nullptr;
+	if (gs && IsValid(gs->SingletonManager))
+	{
+		return gs->SingletonManager;
+	}
+	return nullptr;
+}
+
+bool ASingletonManagerActor::CanStep(AActor* actor)
+{
+	// 活著的actor被ConditionalBeginDestroy時不會呼叫EndPlay
+	return IsValid(actor) && !actor->HasAnyFlags(RF_BeginDestroyed);
+}
+
+template<typename T>
+void ASingletonManagerActor::Register(TArray<T*>& Array, T* actor)
+{
+	if (!IsValid(actor) || ManagedIndex.Contains(actor))
+	{
+		return;
+	}
+	ManagedIndex.Add(actor, Array.Add(actor));
+}
+
+template<typename T>
+void ASingletonManagerActor::Unregister(TArray<T*>& Array, T* actor)
+{
+	int32 idx;
+	if (!ManagedIndex.RemoveAndCopyValue(actor, idx))
+	{
+		return;
+	}
+	if (Stepping)
+	{
+		Array[idx] = nullptr;
+	}
+	else
+	{
+		RemoveSlot(Array, idx);
+	}
+}
+
+template<typename T>
+void ASingletonManagerActor::RemoveSlot(TArray<T*>& Array, int32 idx)
+{
+	Array.RemoveAtSwap(idx, 1, false);
+	if (idx < Array.Num() && Array[idx])
+	{
+		ManagedIndex.FindChecked(Array[idx]) = idx;
+	}
+}
+
+template<typename T>
+void ASingletonManagerActor::Compact(TArray<T*>& Array)
+{
+	// 從後面檢查 換過來的欄位已經檢查過了
+	for (int32 i = Array.Num() - 1; i >= 0; --i)
+	{
+		if (!CanStep(Array[i]))
+		{
+			if (Array[i])
+			{
+				ManagedIndex.Remove(Array[i]);
+			}
+			RemoveSlot(Array, i);
+		}
+	}
+}
+
+void ASingletonManagerActor::RegisterUnit(ABasicUnit* unit)
+{
+	Register(Units, unit);
+	if (IsValid(unit))
+	{
+		unit->SimulationManaged = true;
+		// 保留單位自己的tick跟tick group 只是排在管理者算完計時之後
+		unit->AddTickPrerequisiteActor(this);
+		// 傷害數字由HUD畫 它的actor用到才回收
+		PrewarmActors(unit->AttackBullet, PrewarmPerClass);
+	}
+}
+
+void ASingletonManagerActor::UnregisterUnit(ABasicUnit* unit)
+{
+	Unregister(Units, unit);
+	if (unit)
+	{
+		unit->SimulationManaged = false;
+		unit->RemoveTickPrerequisiteActor(this);
+	}
+}
+
+void ASingletonManagerActor::RegisterBuff(AHeroBuff* buff)
+{
+	Register(Buffs, buff);
+	if (IsValid(buff))
+	{
+		buff->SetSimulationManaged(true);
+		// 藍圖的Event Tick還是要跑 計時由時間輪負責 Tick裡不會再算
+		if (!buff->HasBlueprintTick())
+		{
+			buff->SetActorTickEnabled(false);
+		}
+	}
+}
+
+void ASingletonManagerActor::UnregisterBuff(AHeroBuff* buff)
+{
+	Unregister(Buffs, buff);
+	if (buff)
+	{
+		buff->SetSimulationManaged(false);
+	}
+}
+
+FTimerWheelHandle ASingletonManagerActor::ScheduleTimer(UObject* target, float Delay)
+{
+	const float now = GetWorld()->GetTimeSeconds();
+	return Timers.Schedule(now, now + FMath::Max(Delay, 0.f), target);
+}
+
+void ASingletonManagerActor::CancelTimer(FTimerWheelHandle& handle)
+{
+	Timers.Cancel(handle);
+}
+
+void ASingletonManagerActor::RegisterActor(AActor* actor)
+{
+	Register(Actors, actor);
+	if (IsValid(actor))
+	{
+		actor->AddTickPrerequisiteActor(this);
+	}
+}
+
+void ASingletonManagerActor::UnregisterActor(AActor* actor)
+{
+	Unregister(Actors, actor);
+	if (actor)
+	{
+		actor->RemoveTickPrerequisiteActor(this);
+	}
+}
+
+bool ASingletonManagerActor::CanPool(const AActor* actor) const
+{
+	if (actor->Role != ROLE_Authority)
+	{
+		return false;
+	}
+	const ENetMode mode = GetNetMode();
+	return !actor->GetIsReplicated() || mode == NM_Standalone || mode == NM_Client;
+}
+
+AActor* ASingletonManagerActor::AcquireActor(UClass* cls, const FTransform& transform)
+{
+	// 有這個entry代表這個class被Acquire過 回收時只保留這些
+	FActorPoolList& pool = Pools.FindOrAdd(cls);
+	while (pool.Actors.Num() > 0)
+	{
+		AActor* actor = pool.Actors.Pop(false);
+		if (!IsValid(actor))
+		{
+			continue;
+		}
+		actor->SetActorTransform(transform, false, nullptr, ETeleportType::TeleportPhysics);
+		actor->SetActorHiddenInGame(false);
+		actor->SetActorEnableCollision(cls->GetDefaultObject<AActor>()->GetActorEnableCollision());
+		actor->SetActorTickEnabled(true);
+		if (IPooledActor* pooled = Cast<IPooledActor>(actor))
+		{
+			pooled->OnPoolAcquired();
+		}
+		return actor;
+	}
+	return GetWorld()->SpawnActor<AActor>(cls, transform);
+}
+
+void ASingletonManagerActor::ReleaseActor(AActor* actor)
+{
+	if (!CanPool(actor) || actor->GetWorld() != GetWorld())
+	{
+		actor->Destroy();
+		return;
+	}
+	// 沒人Acquire這個class(例如Blueprint的SpawnActor) 回收了也不會被重用
+	FActorPoolList* pool = Pools.Find(actor->GetClass());
+	if (!pool)
+	{
+		actor->Destroy();
+		return;
+	}
+	if (pool->Actors.Contains(actor))
+	{
+		return;
+	}
+	if (pool->Actors.Num() >= MaxPooledPerClass)
+	{
+		actor->Destroy();
+		return;
+	}
+	if (IPooledActor* pooled = Cast<IPooledActor>(actor))
+	{
+		pooled->OnPoolReleased();
+	}
+	actor->SetActorHiddenInGame(true);
+	actor->SetActorEnableCollision(false);
+	actor->SetActorTickEnabled(false);
+	pool->Actors.Add(actor);
+}
+
+void ASingletonManagerActor::Release(AActor* actor)
+{
+	if (!IsValid(actor))
+	{
+		return;
+	}
+	if (ASingletonManagerActor* sm = Get(actor))
+	{
+		sm->ReleaseActor(actor);
+	}
+	else
+	{
+		actor->Destroy();
+	}
+}
+
+void ASingletonManagerActor::PrewarmActors(UClass* cls, int32 count)
+{
+	if (!cls || !CanPool(cls->GetDefaultObject<AActor>()))
+	{
+		return;
+	}
+	count = FMath::Min(count, MaxPooledPerClass);
+	for (int32 i = Pools.FindOrAdd(cls).Actors.Num(); i < count; ++i)
+	{
+		AActor* actor = GetWorld()->SpawnActor<AActor>(cls, FTransform::Identity);
+		if (!actor)
+		{
+			break;
+		}
+		ReleaseActor(actor);
+	}
+}
+
+AActor* ASingletonManagerActor::AcquirePooledActor(UObject* WorldContextObject, TSubclassOf<AActor> cls, const FTransform& transform)
+{
+	UWorld* world = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	return Acquire<AActor>(world, cls, transform);
+}
+
+void ASingletonManagerActor::ReleasePooledActor(AActor* actor)
+{
+	Release(actor);
 }
 
 // Called every frame
 void ASingletonManagerActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+	Compact(Units);
+	Compact(Buffs);
+	Compact(Actors);
 
-}
+	// 更新中才註冊的下一幀才開始
+	const int32 unitCount = Units.Num();
+	Stepping = true;
 
+	// 每個單位自己的delta 引擎會用CustomTimeDilation縮放actor的tick
+	UnitDeltaTime.SetNumUninitialized(unitCount, false);
+	for (int32 i = 0; i < unitCount; ++i)
+	{
+		UnitDeltaTime[i] = DeltaTime * Units[i]->CustomTimeDilation;
+	}
+	// 持續施法跟技能CD會進藍圖 依序做 順便挑出這幀要更新血魔攻速的單位
+	// 每個單位的Frame錯開 每幀大約只有1/7的單位要算
+	DueUnits.Reset();
+	for (int32 i = 0; i < unitCount; ++i)
+	{
+		if (CanStep(Units[i]))
+		{
+			Units[i]->ApplyTimers(UnitDeltaTime[i]);
+			if (Units[i]->IsSimulationDue())
+			{
+				DueUnits.Add(i);
+			}
+		}
+	}
+	// 計算階段: worker thread只讀單位 回復跟血魔攻速寫進UnitResults
+	// game thread以外不修改任何UObject
+	const int32 dueCount = DueUnits.Num();
+	UnitResults.SetNum(dueCount, false);
+	ParallelFor(dueCount, [this](int32 i)
+	{
+		// 藍圖事件裡取消註冊的欄位已經清空
+		const int32 idx = DueUnits[i];
+		if (const ABasicUnit* unit = Units[idx])
+		{
+			unit->ComputeSimulation(UnitDeltaTime[idx], UnitResults[i]);
+		}
+	}, dueCount < ParallelMinCount);
+
+	// 套用階段: replicate的寫入依序做
+	for (int32 i = 0; i < dueCount; ++i)
+	{
+		ABasicUnit* unit = Units[DueUnits[i]];
+		if (CanStep(unit))
+		{
+			unit->ApplySimulation(UnitResults[i]);
+		}
+	}
+	// buff的間隔跟到期 技能冷卻
+	Timers.Advance(GetWorld()->GetTimeSeconds(), DueTimers);
+	for (const FTimerWheelEvent& due : DueTimers)
+	{
+		UObject* target = due.Target.Get();
+		if (AHeroBuff* buff = Cast<AHeroBuff>(target))
+		{
+			buff->OnTimerDue(due.Handle);
+		}
+		else if (AHeroSkill* skill = Cast<AHeroSkill>(target))
+		{
+			skill->OnTimerDue(due.Handle);
+		}
+	}
+	// 單位的狀態機跟其他actor之後由引擎照各自的tick group tick
+	Stepping = false;
+}
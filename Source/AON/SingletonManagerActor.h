@@ -1,11 +1,29 @@
-// Fill out your copyright notice in the Description page of Project Settings.
+﻿// Fill out your copyright notice in the Description page of Project Settings.
 
 #pragma once
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "TimerWheel.h"
+#include "UnitSimulation.h"
 #include "SingletonManagerActor.generated.h"
 
+class ABasicUnit;
+class AHeroBuff;
+
+// 同一個class回收的actor
+USTRUCT()
+struct FActorPoolList
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AActor*> Actors;
+};
+
+// 整場比賽的模擬管理者
+// 單位跟actor保留自己的tick 只是把管理者設成tick的前置 每幀都在管理者之後才tick
+// 單位的回復跟計時在這裡先一起算完 buff的計時跟技能冷卻放在時間輪 時間到才處理
 UCLASS()
 class AON_API ASingletonManagerActor : public AActor
 {
@@ -19,10 +37,121 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
-	
-	
+	// 這個world的game state上的管理者 還沒生出來時是null
+	static ASingletonManagerActor* Get(const UObject* WorldContextObject);
+
+	void RegisterUnit(ABasicUnit* unit);
+	void UnregisterUnit(ABasicUnit* unit);
+
+	// 註冊的buff由時間輪叫醒 藍圖沒有Event Tick的就不tick
+	void RegisterBuff(AHeroBuff* buff);
+	void UnregisterBuff(AHeroBuff* buff);
+
+	// 遊戲時間過了Delay秒後用handle呼叫target的OnTimerDue
+	// 只會呼叫AHeroBuff跟AHeroSkill
+	FTimerWheelHandle ScheduleTimer(UObject* target, float Delay);
+
+	// 過期的handle也可以傳 呼叫完handle一定失效
+	void CancelTimer(FTimerWheelHandle& handle);
+
+	// 子彈 傷害數字 場景物件 在管理者之後才tick
+	void RegisterActor(AActor* actor);
+	void UnregisterActor(AActor* actor);
+
+	// 註冊的單位數量
+	int32 GetUnitCount() const { return Units.Num(); }
+
+	// 重用同class回收的actor 沒有就生一個新的
+	// 沒有管理者時直接生
+	template<typename T>
+	static T* Acquire(UWorld* world, TSubclassOf<T> cls, const FTransform& transform)
+	{
+		if (!cls || !world)
+		{
+			return nullptr;
+		}
+		if (ASingletonManagerActor* sm = Get(world))
+		{
+			return Cast<T>(sm->AcquireActor(cls, transform));
+		}
+		return world->SpawnActor<T>(cls, transform);
+	}
+
+	// 藏起來留給Acquire用 不能回收或這個class從沒Acquire過就直接destroy
+	static void Release(AActor* actor);
+
+	// 先生好回收的actor 直到這個class有count個
+	void PrewarmActors(UClass* cls, int32 count);
+
+	UFUNCTION(BlueprintCallable, Category = "MOBA", meta = (WorldContext = "WorldContextObject", DeterminesOutputType = "cls"))
+	static AActor* AcquirePooledActor(UObject* WorldContextObject, TSubclassOf<AActor> cls, const FTransform& transform);
+
+	UFUNCTION(BlueprintCallable, Category = "MOBA")
+	static void ReleasePooledActor(AActor* actor);
+
+private:
+	template<typename T>
+	void Register(TArray<T*>& Array, T* actor);
+
+	template<typename T>
+	void Unregister(TArray<T*>& Array, T* actor);
+
+	template<typename T>
+	void Compact(TArray<T*>& Array);
+
+	// 用swap移除idx 並修正換過來的actor的index
+	template<typename T>
+	void RemoveSlot(TArray<T*>& Array, int32 idx);
+
+	static bool CanStep(AActor* actor);
+
+	AActor* AcquireActor(UClass* cls, const FTransform& transform);
+
+	void ReleaseActor(AActor* actor);
+
+	// server上會replicate的actor交給引擎 藏起來的回收品對client還是relevant
+	bool CanPool(const AActor* actor) const;
+
+	// 每個class最多保留的回收數量
+	static const int32 MaxPooledPerClass = 256;
+
+	// 每個單位的攻擊子彈先生好的數量
+	static const int32 PrewarmPerClass = 8;
+
+	// 少於這個數量就在game thread算 開task的成本比省下來的多
+	static const int32 ParallelMinCount = 64;
+
+	// 單位跟每幀的模擬狀態 index相同
+	UPROPERTY()
+	TArray<ABasicUnit*> Units;
+	TArray<float> UnitDeltaTime;
+	// 這幀要更新血魔攻速的單位index 跟平行計算階段填的結果 index相同
+	TArray<int32> DueUnits;
+	TArray<FUnitSimulation> UnitResults;
+
+	// 交給時間輪的buff 只為了在EndPlay把tick還回去
+	UPROPERTY()
+	TArray<AHeroBuff*> Buffs;
+
+	FTimerWheel Timers;
+	TArray<FTimerWheelEvent> DueTimers;
+
+	// 只為了在EndPlay拿掉tick前置
+	UPROPERTY()
+	TArray<AActor*> Actors;
+
+	// 更新中移除只清空欄位
+	bool Stepping = false;
+
+	// 每個註冊的單位 buff actor在陣列裡的位置
+	TMap<AActor*, int32> ManagedIndex;
+
+	UPROPERTY()
+	TMap<UClass*, FActorPoolList> Pools;
 };
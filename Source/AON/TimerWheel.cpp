@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TimerWheel.h"
+
+FTimerWheel::FTimerWheel()
+{
+	for (int32& head : Heads)
+	{
+		head = INDEX_NONE;
+	}
+}
+
+FTimerWheelHandle FTimerWheel::Schedule(float Now, float DueTime, UObject* Target)
+{
+	// an empty wheel can skip straight to the present
+	if (Count == 0)
+	{
+		CurrentTick = FMath::Max(CurrentTick, ToTick(Now));
+	}
+	int32 idx = FreeHead;
+	if (idx != INDEX_NONE)
+	{
+		FreeHead = Entries[idx].Next;
+	}
+	else
+	{
+		idx = Entries.AddDefaulted();
+	}
+	FEntry& entry = Entries[idx];
+	entry.Due = DueTime;
+	// already due timers go in the current slot, fired by the next Advance
+	entry.Tick = FMath::Max(ToTick(DueTime), CurrentTick);
+	entry.Target = Target;
+	Link(idx);
+	Count++;
+	FTimerWheelHandle handle;
+	handle.Index = idx;
+	handle.Serial = entry.Serial;
+	return handle;
+}
+
+void FTimerWheel::Cancel(FTimerWheelHandle& Handle)
+{
+	if (Entries.IsValidIndex(Handle.Index))
+	{
+		FEntry& entry = Entries[Handle.Index];
+		if (entry.Serial == Handle.Serial && entry.Slot != INDEX_NONE)
+		{
+			Unlink(Handle.Index);
+			Free(Handle.Index);
+		}
+	}
+	Handle.Invalidate();
+}
+
+void FTimerWheel::Advance(float Now, TArray<FTimerWheelEvent>& Out)
+{
+	Out.Reset();
+	const int64 target = ToTick(Now);
+	if (Count == 0)
+	{
+		CurrentTick = FMath::Max(CurrentTick, target);
+		return;
+	}
+	for (;;)
+	{
+		// the slot of the current tick, may still hold timers due later in the tick
+		const int32 slot = (int32)(CurrentTick & (SlotCount - 1));
+		int32 idx = Heads[slot];
+		while (idx != INDEX_NONE)
+		{
+			const int32 next = Entries[idx].Next;
+			if (Entries[idx].Due <= Now || Entries[idx].Tick < target)
+			{
+				FTimerWheelEvent& e = Out.AddDefaulted_GetRef();
+				e.Target = Entries[idx].Target;
+				e.Handle.Index = idx;
+				e.Handle.Serial = Entries[idx].Serial;
+				Unlink(idx);
+				Free(idx);
+			}
+			idx = next;
+		}
+		if (CurrentTick >= target || Count == 0)
+		{
+			break;
+		}
+		CurrentTick++;
+		// higher levels first, their timers may land in a lower slot turning over now
+		for (int32 level = LevelCount - 1; level > 0; --level)
+		{
+			if ((CurrentTick & (((int64)1 << (level * SlotBits)) - 1)) == 0)
+			{
+				Cascade(level);
+			}
+		}
+	}
+	CurrentTick = FMath::Max(CurrentTick, target);
+}
+
+void FTimerWheel::Empty()
+{
+	Entries.Empty();
+	FreeHead = INDEX_NONE;
+	for (int32& head : Heads)
+	{
+		head = INDEX_NONE;
+	}
+	Count = 0;
+}
+
+int32 FTimerWheel::SlotFor(int64 Tick) const
+{
+	const int64 diff = Tick ^ CurrentTick;
+	for (int32 level = 0; level < LevelCount - 1; ++level)
+	{
+		if ((diff >> ((level + 1) * SlotBits)) == 0)
+		{
+			return level * SlotCount + (int32)((Tick >> (level * SlotBits)) & (SlotCount - 1));
+		}
+	}
+	// the top level wraps around, any block less than a full turn ahead has its own slot
+	const int32 top = LevelCount - 1;
+	const int64 block = Tick >> (top * SlotBits);
+	const int64 current = CurrentTick >> (top * SlotBits);
+	if (block - current < SlotCount)
+	{
+		return top * SlotCount + (int32)(block & (SlotCount - 1));
+	}
+	// further out: park in the slot furthest away, re-placed when it turns over
+	return top * SlotCount + (int32)((current + SlotCount - 1) & (SlotCount - 1));
+}
+
+void FTimerWheel::Link(int32 Index)
+{
+	FEntry& entry = Entries[Index];
+	entry.Slot = SlotFor(entry.Tick);
+	entry.Prev = INDEX_NONE;
+	entry.Next = Heads[entry.Slot];
+	if (entry.Next != INDEX_NONE)
+	{
+		Entries[entry.Next].Prev = Index;
+	}
+	Heads[entry.Slot] = Index;
+}
+
+void FTimerWheel::Unlink(int32 Index)
+{
+	FEntry& entry = Entries[Index];
+	if (entry.Prev != INDEX_NONE)
+	{
+		Entries[entry.Prev].Next = entry.Next;
+	}
+	else
+	{
+		Heads[entry.Slot] = entry.Next;
+	}
+	if (entry.Next != INDEX_NONE)
+	{
+		Entries[entry.Next].Prev = entry.Prev;
+	}
+	entry.Prev = INDEX_NONE;
+	entry.Next = INDEX_NONE;
+}
+
+void FTimerWheel::Free(int32 Index)
+{
+	FEntry& entry = Entries[Index];
+	entry.Slot = INDEX_NONE;
+	entry.Target.Reset();
+	// stale handles stop matching
+	entry.Serial++;
+	entry.Next = FreeHead;
+	FreeHead = Index;
+	Count--;
+}
+
+void FTimerWheel::Cascade(int32 Level)
+{
+	const int32 slot = Level * SlotCount + (int32)((CurrentTick >> (Level * SlotBits)) & (SlotCount - 1));
+	Scratch.Reset();
+	for (int32 idx = Heads[slot]; idx != INDEX_NONE; idx = Entries[idx].Next)
+	{
+		Scratch.Add(idx);
+	}
+	Heads[slot] = INDEX_NONE;
+	for (int32 idx : Scratch)
+	{
+		Link(idx);
+	}
+}
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtr.h"
+
+struct FTimerWheelHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+	void Invalidate() { Index = INDEX_NONE; }
+
+	bool operator==(const FTimerWheelHandle& Other) const
+	{
+		return Index == Other.Index && Serial == Other.Serial;
+	}
+	bool operator!=(const FTimerWheelHandle& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+// A timer that came due, the owner compares Handle with the one it kept
+// since a cancel between Advance and dispatch can't pull it back out
+struct FTimerWheelEvent
+{
+	TWeakObjectPtr<UObject> Target;
+	FTimerWheelHandle Handle;
+};
+
+// Hierarchical timing wheel keyed on game time.
+// Level 0 has SlotCount slots of one tick, each next level SlotCount slots
+// spanning a whole turn of the level below. Timers only move when a level
+// turns over, so an idle timer costs nothing until it is due.
+class AON_API FTimerWheel
+{
+public:
+	FTimerWheel();
+
+	// Calls back Target once game time reaches DueTime, Now is the current game time
+	FTimerWheelHandle Schedule(float Now, float DueTime, UObject* Target);
+
+	// Safe on stale or invalid handles, always invalidates Handle
+	void Cancel(FTimerWheelHandle& Handle);
+
+	// Moves every timer due by Now to Out. Timers scheduled while the caller
+	// dispatches Out come due on the next Advance at the earliest.
+	void Advance(float Now, TArray<FTimerWheelEvent>& Out);
+
+	void Empty();
+
+	int32 Num() const { return Count; }
+
+private:
+	static const int32 SlotBits = 6;
+	static const int32 SlotCount = 1 << SlotBits;
+	static const int32 LevelCount = 4;
+	// ticks per second, level 0 turns once a second and level 3 every ~73 hours
+	static constexpr float TickRate = 64.f;
+
+	struct FEntry
+	{
+		float Due = 0;
+		int64 Tick = 0;
+		TWeakObjectPtr<UObject> Target;
+		uint32 Serial = 0;
+		int32 Prev = INDEX_NONE;
+		int32 Next = INDEX_NONE;
+		// level * SlotCount + slot, INDEX_NONE when free
+		int32 Slot = INDEX_NONE;
+	};
+
+	static int64 ToTick(float Time)
+	{
+		return (int64)FMath::FloorToDouble((double)Time * TickRate);
+	}
+
+	// Picks the slot from the highest tick digit that differs from CurrentTick
+	int32 SlotFor(int64 Tick) const;
+
+	void Link(int32 Index);
+	void Unlink(int32 Index);
+	void Free(int32 Index);
+
+	// Re-links the slot of level the current tick just entered
+	void Cascade(int32 Level);
+
+	TArray<FEntry> Entries;
+	int32 FreeHead = INDEX_NONE;
+	int32 Heads[LevelCount * SlotCount];
+	int64 CurrentTick = 0;
+	int32 Count = 0;
+	TArray<int32> Scratch;
+};
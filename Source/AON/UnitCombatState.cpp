@@ -0,0 +1,57 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "UnitCombatState.h"
+
+bool FUnitCombatState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	enum : uint8
+	{
+		Alive = 1,
+		HasShield = 2,
+		HasShieldPhysical = 4,
+		HasShieldMagical = 8,
+		HasSkillPoints = 16,
+	};
+	uint8 Flags = 0;
+	if (Ar.IsSaving())
+	{
+		Flags |= IsAlive ? Alive : 0;
+		Flags |= Shield != 0 ? HasShield : 0;
+		Flags |= ShieldPhysical != 0 ? HasShieldPhysical : 0;
+		Flags |= ShieldMagical != 0 ? HasShieldMagical : 0;
+		Flags |= SkillPoints != 0 ? HasSkillPoints : 0;
+	}
+	Ar << Flags;
+	Ar << HP;
+	Ar << MP;
+	// 沒有護盾跟技能點的單位不用送
+	if (Ar.IsLoading())
+	{
+		IsAlive = (Flags & Alive) != 0;
+		Shield = 0;
+		ShieldPhysical = 0;
+		ShieldMagical = 0;
+		SkillPoints = 0;
+		Revision++;
+	}
+	if (Flags & HasShield)
+	{
+		Ar << Shield;
+	}
+	if (Flags & HasShieldPhysical)
+	{
+		Ar << ShieldPhysical;
+	}
+	if (Flags & HasShieldMagical)
+	{
+		Ar << ShieldMagical;
+	}
+	if (Flags & HasSkillPoints)
+	{
+		uint32 Points = (uint32)SkillPoints;
+		Ar.SerializeIntPacked(Points);
+		SkillPoints = (int32)Points;
+	}
+	bOutSuccess = true;
+	return true;
+}
@@ -0,0 +1,63 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UnitCombatState.generated.h"
+
+// 單位戰鬥狀態的同步快照 伺服器改值時要加Revision
+// 網路比對只看Revision 沒改過的單位每次只比一個整數
+USTRUCT()
+struct AON_API FUnitCombatState
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	float HP = 0;
+
+	UPROPERTY()
+	float MP = 0;
+
+	UPROPERTY()
+	float Shield = 0;
+
+	UPROPERTY()
+	float ShieldPhysical = 0;
+
+	UPROPERTY()
+	float ShieldMagical = 0;
+
+	UPROPERTY()
+	int32 SkillPoints = 0;
+
+	UPROPERTY()
+	bool IsAlive = true;
+
+	// 不會送出 收到新值時用戶端自己加 讓OnRep觸發
+	uint32 Revision = 0;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	// 不比Revision 打包前用來判斷要不要加Revision
+	bool SameValues(const FUnitCombatState& Other) const
+	{
+		return HP == Other.HP && MP == Other.MP && Shield == Other.Shield
+			&& ShieldPhysical == Other.ShieldPhysical && ShieldMagical == Other.ShieldMagical
+			&& SkillPoints == Other.SkillPoints && IsAlive == Other.IsAlive;
+	}
+
+	bool Identical(const FUnitCombatState* Other, uint32 PortFlags) const
+	{
+		return Revision == Other->Revision;
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FUnitCombatState> : public TStructOpsTypeTraitsBase2<FUnitCombatState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdentical = true,
+	};
+};
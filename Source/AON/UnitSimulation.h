@@ -0,0 +1,28 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// 單位每7幀寫回的值 由ABasicUnit::ComputeSimulation只讀算出
+// 可以在工作執行緒上填 再由ApplySimulation在遊戲執行緒寫回
+struct FUnitSimulation
+{
+	// 自然回復後的血魔
+	float HP = 0;
+	float MP = 0;
+
+	// 血魔攻速 跟UpdateHPMPAS算的一樣
+	float MaxHP = 0;
+	float RegenHP = 0;
+	float MaxMP = 0;
+	float RegenMP = 0;
+	float Attack = 0;
+	float AttackSpeed = 0;
+	float AttackSpeedSecond = 0;
+	float Armor = 0;
+	float AttackingAnimationTimeLength = 0;
+	float AttackingAnimationRate = 0;
+	float AttackingBeginingTimeLength = 0;
+	float AttackingEndingTimeLength = 0;
+};
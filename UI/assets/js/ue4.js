@@ -27,10 +27,75 @@ if (typeof ue == "object" && typeof ue.interface == "object") {
         ue.interface.setCurrentHero = setCurrentHero;
         ue.interface.focusUnit = focusUnit;
         ue.interface.lostFocusUnit = lostFocusUnit;
+        ue.interface.patchUnit = patchUnit;
+        ue.interface.setUnitBinary = setUnitBinary;
 
     })(ue.interface);
 }    
 
+// 跟HUDSnapshot.h的EHUDUnitField EHUDSkillField EHUDBuffField同樣順序
+var HUDUnitFields = ["TeamId", "IsAlive", "CurrentMoveSpeed", "CurrentMaxHP", "CurrentHP",
+    "CurrentShield", "CurrentShieldPhysical", "CurrentShieldMagical", "CurrentMaxMP", "CurrentMP",
+    "CurrentRegenHP", "CurrentRegenMP", "CurrentAttackSpeed", "CurrentAttackSpeedSecond", "CurrentAttack",
+    "CurrentArmor", "CurrentAttackRange", "CurrentMagicInjured", "CurrentSkillIndex", "CurrentSkillPoints",
+    "StunningLeftCounting", "BountyGold", "BaseAttack", "BaseArmor", "BaseMoveSpeed",
+    "BaseAttackRange", "Skill_Amount", "Buff_Amount", "AdditionStrength", "AdditionAgility",
+    "AdditionIntelligence", "DeadTime", "BountyEXP", "Strength", "Agility",
+    "Intelligence", "CurrentLevel", "CurrentEXP"];
+var HUDSkillFields = ["Enabled", "Toggle", "Display", "CDPercent", "CurrentCD",
+    "MaxCD", "CanLevelUp", "CurrentLevel", "MaxLevel"];
+var HUDBuffFields = ["Friendly", "Stacks", "Duration", "MaxDuration", "CanStacks"];
+// 跟FUnitHUDSnapshot的UnitBoolFields SkillBoolFields BuffBoolFields一樣 用bit送
+var HUDUnitBools = ["IsAlive"];
+var HUDSkillBools = ["Enabled", "Toggle", "Display", "CanLevelUp"];
+var HUDBuffBools = ["Friendly", "CanStacks"];
+// 目前選取單位的所有欄位
+var HUDUnit = {};
+
+// 只會收到有變的文字欄位
+function patchUnit(val) {
+    for (var k in val) {
+        HUDUnit[k] = val[k];
+    }
+    HUDUnit.HeroName = HUDUnit.UnitName;
+    setCurrentHero(HUDUnit);
+}
+
+function setUnitBinary(b64) {
+    var bin = atob(b64);
+    var bytes = new Uint8Array(bin.length);
+    for (var i = 0; i < bin.length; ++i) {
+        bytes[i] = bin.charCodeAt(i);
+    }
+    var view = new DataView(bytes.buffer);
+    var skills = view.getUint16(0, true);
+    var buffs = view.getUint16(2, true);
+    var n = 4;
+    n = readHUDSection(view, n, "", HUDUnitFields, HUDUnitBools);
+    for (var s = 1; s <= skills; ++s) {
+        n = readHUDSection(view, n, "Skill" + s + "_", HUDSkillFields, HUDSkillBools);
+    }
+    for (var b = 1; b <= buffs; ++b) {
+        n = readHUDSection(view, n, "Buff" + b + "_", HUDBuffFields, HUDBuffBools);
+    }
+    setCurrentHero(HUDUnit);
+}
+
+// 先讀布林欄位的bit 再照順序讀其他欄位的float 回傳下一段的位置
+function readHUDSection(view, n, prefix, fields, bools) {
+    for (var i = 0; i < bools.length; ++i) {
+        HUDUnit[prefix + bools[i]] = (view.getUint8(n + (i >> 3)) >> (i & 7)) & 1;
+    }
+    n += (bools.length + 7) >> 3;
+    for (var i = 0; i < fields.length; ++i) {
+        if (bools.indexOf(fields[i]) < 0) {
+            HUDUnit[prefix + fields[i]] = view.getFloat32(n, true);
+            n += 4;
+        }
+    }
+    return n;
+}
+
 function focusUnit(val) {
     ue4("debug", val);
 }